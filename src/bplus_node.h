@@ -0,0 +1,670 @@
+#pragma once
+#include "node.h"
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+
+using namespace std;
+
+// Node of the B+-tree. Inner nodes hold only separators and children, leaves hold every
+// key with its record address and are linked to their neighbours.
+// Keys of a fixed width type are stored as they are, ordered by Compare.
+template <size_t PageBytes, typename K = Key, typename Compare = less<K>, NODE_ENCODING Encoding = PLAIN_NODES>
+struct BPlusNode{
+    static_assert(is_trivially_copyable<K>::value, "BPlusNode: fixed width keys must be trivially copyable");
+    static_assert(Encoding == PLAIN_NODES, "BPlusNode: compact nodes need long long keys in ascending order");
+
+    bool leaf = false;
+    Page prev = NULL_PAGE;
+    Page next = NULL_PAGE;
+    vector<K> keys;
+    vector<Address> addresses;
+    vector<Page> children;
+
+    static const size_t HEADER_SIZE = sizeof(bool) + sizeof(int) + 2 * sizeof(Page);
+    static const size_t ADDRESS_SIZE = sizeof(Page) + sizeof(int);
+    static const int LEAF_MAX = (PageBytes - HEADER_SIZE) / (sizeof(K) + ADDRESS_SIZE);
+    static const int LEAF_MIN = LEAF_MAX / 2;
+    static const int INNER_MAX = (PageBytes - HEADER_SIZE - sizeof(Page)) / (sizeof(K) + sizeof(Page));
+    static const int INNER_MIN = INNER_MAX / 2;
+    static const size_t size = PageBytes;
+    // Stored as the order in the superblock, so a B-tree file is not mistaken for a B+-tree
+    static const int FORMAT = -1;
+
+    static_assert(PageBytes % SECTOR_SIZE == 0, "BPlusNode: page size must be a multiple of SECTOR_SIZE");
+    static_assert(LEAF_MAX >= 3 && INNER_MAX >= 3, "BPlusNode: page is too small");
+
+    static const size_t LEAF_OFFSET = 0;
+    static const size_t COUNT_OFFSET = LEAF_OFFSET + sizeof(bool);
+    static const size_t PREV_OFFSET = COUNT_OFFSET + sizeof(int);
+    static const size_t NEXT_OFFSET = PREV_OFFSET + sizeof(Page);
+    static const size_t KEYS_OFFSET = NEXT_OFFSET + sizeof(Page);
+
+    static bool equal(const K &a, const K &b){
+        return !Compare()(a, b) && !Compare()(b, a);
+    }
+
+    // Separator the parent keeps between a left node ending with low and a right node starting with high
+    static K separator(const K &, const K &high){
+        return high;
+    }
+
+    static void checkKey(const K &){}
+
+    int maxKeys() const{
+        return leaf ? LEAF_MAX : INNER_MAX;
+    }
+
+    int minKeys() const{
+        return leaf ? LEAF_MIN : INNER_MIN;
+    }
+
+    bool overflows() const{
+        return (int)keys.size() > maxKeys();
+    }
+
+    bool underflows() const{
+        return (int)keys.size() < minKeys();
+    }
+
+    // First key of the right half when an overflowing node splits, the middle key for inner nodes
+    int splitPoint() const{
+        return leaf ? (int)(keys.size() + 1) / 2 : (int)keys.size() / 2;
+    }
+
+    // Keys held and keys the node could hold
+    pair<int, int> usage() const{
+        return {(int)keys.size(), maxKeys()};
+    }
+
+    // Index of the child that may contain key
+    int searchPlace(const K &key) const{
+        if constexpr(is_same<K, Key>::value && is_same<Compare, less<Key>>::value){
+            return rankSearch((const Byte*)keys.data(), (int)keys.size(), key);
+        }
+        return upper_bound(keys.begin(), keys.end(), key, Compare()) - keys.begin();
+    }
+
+    // Index of the first key not less than key
+    int lowerBound(const K &key) const{
+        return lower_bound(keys.begin(), keys.end(), key, Compare()) - keys.begin();
+    }
+
+    int searchChild(Page page) const{
+        for(int i = 0; i < (int)children.size(); i++){
+            if(children[i] == page){
+                return i;
+            }
+        }
+        return NULL_PAGE;
+    }
+
+    Data serialize() const{
+        Data data(size, 0);
+        int count = (int)keys.size();
+
+        memcpy(data.data() + LEAF_OFFSET, &leaf, sizeof(leaf));
+        memcpy(data.data() + COUNT_OFFSET, &count, sizeof(count));
+        memcpy(data.data() + PREV_OFFSET, &prev, sizeof(prev));
+        memcpy(data.data() + NEXT_OFFSET, &next, sizeof(next));
+        memcpy(data.data() + KEYS_OFFSET, keys.data(), count * sizeof(K));
+
+        size_t offset = KEYS_OFFSET + maxKeys() * sizeof(K);
+        if(leaf){
+            for(const Address &address : addresses){
+                memcpy(data.data() + offset, &address.page, sizeof(address.page));
+                offset += sizeof(address.page);
+                memcpy(data.data() + offset, &address.offset, sizeof(address.offset));
+                offset += sizeof(address.offset);
+            }
+        }
+        else{
+            memcpy(data.data() + offset, children.data(), children.size() * sizeof(Page));
+        }
+        return data;
+    }
+
+    static BPlusNode deserialize(const Data &data){
+        BPlusNode node;
+        int count;
+
+        memcpy(&node.leaf, data.data() + LEAF_OFFSET, sizeof(node.leaf));
+        memcpy(&count, data.data() + COUNT_OFFSET, sizeof(count));
+        memcpy(&node.prev, data.data() + PREV_OFFSET, sizeof(node.prev));
+        memcpy(&node.next, data.data() + NEXT_OFFSET, sizeof(node.next));
+
+        node.keys.resize(count);
+        memcpy(node.keys.data(), data.data() + KEYS_OFFSET, count * sizeof(K));
+
+        size_t offset = KEYS_OFFSET + node.maxKeys() * sizeof(K);
+        if(node.leaf){
+            node.addresses.resize(count);
+            for(Address &address : node.addresses){
+                memcpy(&address.page, data.data() + offset, sizeof(address.page));
+                offset += sizeof(address.page);
+                memcpy(&address.offset, data.data() + offset, sizeof(address.offset));
+                offset += sizeof(address.offset);
+            }
+        }
+        else{
+            node.children.resize(count + 1);
+            memcpy(node.children.data(), data.data() + offset, (count + 1) * sizeof(Page));
+        }
+        return node;
+    }
+};
+
+// Split point of a node of count keys closest to point at which both halves fit, a leaf keeps at least
+// one key on each side and an inner node also one to move up
+template <typename Fits>
+int nearestSplit(int point, int count, bool leaf, Fits fits){
+    int low = 1, high = count - (leaf ? 1 : 2);
+    point = max(low, min(point, high));
+    for(int distance = 0; point - distance >= low || point + distance <= high; distance++){
+        if(point - distance >= low && fits(point - distance)){
+            return point - distance;
+        }
+        if(point + distance <= high && fits(point + distance)){
+            return point + distance;
+        }
+    }
+    throw logic_error("BPlusNode: no split of the node fits two pages");
+}
+
+// Node of the B+-tree over variable length string keys, filled by bytes instead of by key count.
+// The page is slotted: the prefix shared by all keys of the node is stored once after the header,
+// followed by a slot (offset, length) per key, the record addresses or children, and the key
+// suffixes packed from the end of the page. Separators in inner nodes are truncated to the
+// shortest prefix that still tells the two children apart.
+template <size_t PageBytes, typename Compare>
+struct BPlusNode<PageBytes, string, Compare, PLAIN_NODES>{
+    using Length = uint16_t;
+
+    bool leaf = false;
+    Page prev = NULL_PAGE;
+    Page next = NULL_PAGE;
+    vector<string> keys;
+    vector<Address> addresses;
+    vector<Page> children;
+
+    static const size_t HEADER_SIZE = sizeof(bool) + sizeof(int) + 2 * sizeof(Page) + sizeof(Length);
+    static const size_t ADDRESS_SIZE = sizeof(Page) + sizeof(int);
+    static const size_t SLOT_SIZE = 2 * sizeof(Length);
+    // Small enough that a node splits into two halves that fit and an emptied inner node can always merge
+    static const size_t MAX_KEY_SIZE = (PageBytes - HEADER_SIZE - sizeof(Page)) / 4 - SLOT_SIZE - ADDRESS_SIZE;
+    static const size_t MIN_SIZE = PageBytes / 2;
+    static const size_t size = PageBytes;
+    static const int FORMAT = -2;
+
+    static_assert(PageBytes % SECTOR_SIZE == 0, "BPlusNode: page size must be a multiple of SECTOR_SIZE");
+    static_assert(PageBytes < 65536, "BPlusNode: slots address less than 64 KiB");
+
+    static const size_t LEAF_OFFSET = 0;
+    static const size_t COUNT_OFFSET = LEAF_OFFSET + sizeof(bool);
+    static const size_t PREV_OFFSET = COUNT_OFFSET + sizeof(int);
+    static const size_t NEXT_OFFSET = PREV_OFFSET + sizeof(Page);
+    static const size_t PREFIX_OFFSET = NEXT_OFFSET + sizeof(Page);
+
+    static bool equal(const string &a, const string &b){
+        return !Compare()(a, b) && !Compare()(b, a);
+    }
+
+    // Shortest prefix of high that is still greater than low, so the parent keeps as few bytes as possible
+    static string separator(const string &low, const string &high){
+        for(size_t length = 1; length < high.size(); length++){
+            string candidate = high.substr(0, length);
+            if(Compare()(low, candidate) && !Compare()(high, candidate)){
+                return candidate;
+            }
+        }
+        return high;
+    }
+
+    static void checkKey(const string &key){
+        if(key.size() > MAX_KEY_SIZE){
+            throw invalid_argument("BPlusNode: key of " + to_string(key.size()) + " bytes, at most " + to_string(MAX_KEY_SIZE) + " fit");
+        }
+    }
+
+    // Length of the prefix shared by the keys in [first, last)
+    static size_t prefixLength(const string *first, const string *last){
+        size_t length = first == last ? 0 : first->size();
+        for(const string *key = first; key != last; key++){
+            length = mismatch(first->begin(), first->begin() + length, key->begin(), key->end()).first - first->begin();
+        }
+        return length;
+    }
+
+    static size_t prefixLength(const vector<string> &keys){
+        return prefixLength(keys.data(), keys.data() + keys.size());
+    }
+
+    // Bytes a node with the keys in [first, last) and their addresses or children takes on its page
+    static size_t encodedSize(bool leaf, const string *first, const string *last){
+        size_t prefix = prefixLength(first, last);
+        size_t bytes = HEADER_SIZE + prefix + (leaf ? 0 : sizeof(Page));
+        for(const string *key = first; key != last; key++){
+            bytes += SLOT_SIZE + key->size() - prefix + (leaf ? ADDRESS_SIZE : sizeof(Page));
+        }
+        return bytes;
+    }
+
+    static size_t encodedSize(bool leaf, const vector<string> &keys){
+        return encodedSize(leaf, keys.data(), keys.data() + keys.size());
+    }
+
+    size_t encodedSize() const{
+        return encodedSize(leaf, keys);
+    }
+
+    bool overflows() const{
+        return encodedSize() > PageBytes;
+    }
+
+    bool underflows() const{
+        return encodedSize() < MIN_SIZE;
+    }
+
+    // Whether both halves fit when the node splits at point
+    bool splitFits(int point) const{
+        const string *first = keys.data(), *last = keys.data() + keys.size();
+        return encodedSize(leaf, first, first + point) <= PageBytes && encodedSize(leaf, first + point + (leaf ? 0 : 1), last) <= PageBytes;
+    }
+
+    // Splits where the bytes of the keys before it first reach half of the node, or as close to that
+    // as both halves fit. A key sharing less of the prefix than the others sorts to an end of the node,
+    // splitting it off leaves the rest as compressed as before.
+    int splitPoint() const{
+        size_t prefix = prefixLength(keys);
+        size_t half = encodedSize() / 2, bytes = HEADER_SIZE + prefix;
+        int point = 0;
+        while(point < (int)keys.size() && bytes < half){
+            bytes += SLOT_SIZE + keys[point].size() - prefix + (leaf ? ADDRESS_SIZE : sizeof(Page));
+            point++;
+        }
+
+        return nearestSplit(point, (int)keys.size(), leaf, [this](int point){ return splitFits(point); });
+    }
+
+    // Bytes used and bytes available
+    pair<int, int> usage() const{
+        return {(int)encodedSize(), (int)PageBytes};
+    }
+
+    int searchPlace(const string &key) const{
+        return upper_bound(keys.begin(), keys.end(), key, Compare()) - keys.begin();
+    }
+
+    int lowerBound(const string &key) const{
+        return lower_bound(keys.begin(), keys.end(), key, Compare()) - keys.begin();
+    }
+
+    int searchChild(Page page) const{
+        for(int i = 0; i < (int)children.size(); i++){
+            if(children[i] == page){
+                return i;
+            }
+        }
+        return NULL_PAGE;
+    }
+
+    Data serialize() const{
+        if(overflows()){
+            throw logic_error("BPlusNode: node of " + to_string(encodedSize()) + " bytes does not fit a page");
+        }
+        Data data(size, 0);
+        int count = (int)keys.size();
+        Length prefix = (Length)prefixLength(keys);
+
+        memcpy(data.data() + LEAF_OFFSET, &leaf, sizeof(leaf));
+        memcpy(data.data() + COUNT_OFFSET, &count, sizeof(count));
+        memcpy(data.data() + PREV_OFFSET, &prev, sizeof(prev));
+        memcpy(data.data() + NEXT_OFFSET, &next, sizeof(next));
+        memcpy(data.data() + PREFIX_OFFSET, &prefix, sizeof(prefix));
+        if(count > 0){
+            memcpy(data.data() + HEADER_SIZE, keys[0].data(), prefix);
+        }
+
+        size_t slots = HEADER_SIZE + prefix;
+        size_t offset = slots + count * SLOT_SIZE;
+        if(leaf){
+            for(const Address &address : addresses){
+                memcpy(data.data() + offset, &address.page, sizeof(address.page));
+                offset += sizeof(address.page);
+                memcpy(data.data() + offset, &address.offset, sizeof(address.offset));
+                offset += sizeof(address.offset);
+            }
+        }
+        else{
+            memcpy(data.data() + offset, children.data(), children.size() * sizeof(Page));
+        }
+
+        size_t end = size;
+        for(int i = 0; i < count; i++){
+            Length length = (Length)(keys[i].size() - prefix);
+            end -= length;
+            Length cell = (Length)end;
+            memcpy(data.data() + end, keys[i].data() + prefix, length);
+            memcpy(data.data() + slots + i * SLOT_SIZE, &cell, sizeof(cell));
+            memcpy(data.data() + slots + i * SLOT_SIZE + sizeof(cell), &length, sizeof(length));
+        }
+        return data;
+    }
+
+    static BPlusNode deserialize(const Data &data){
+        BPlusNode node;
+        int count;
+        Length prefix;
+
+        memcpy(&node.leaf, data.data() + LEAF_OFFSET, sizeof(node.leaf));
+        memcpy(&count, data.data() + COUNT_OFFSET, sizeof(count));
+        memcpy(&node.prev, data.data() + PREV_OFFSET, sizeof(node.prev));
+        memcpy(&node.next, data.data() + NEXT_OFFSET, sizeof(node.next));
+        memcpy(&prefix, data.data() + PREFIX_OFFSET, sizeof(prefix));
+
+        string shared((const char*)data.data() + HEADER_SIZE, prefix);
+        size_t slots = HEADER_SIZE + prefix;
+        node.keys.resize(count);
+        for(int i = 0; i < count; i++){
+            Length cell, length;
+            memcpy(&cell, data.data() + slots + i * SLOT_SIZE, sizeof(cell));
+            memcpy(&length, data.data() + slots + i * SLOT_SIZE + sizeof(cell), sizeof(length));
+            node.keys[i] = shared;
+            node.keys[i].append((const char*)data.data() + cell, length);
+        }
+
+        size_t offset = slots + count * SLOT_SIZE;
+        if(node.leaf){
+            node.addresses.resize(count);
+            for(Address &address : node.addresses){
+                memcpy(&address.page, data.data() + offset, sizeof(address.page));
+                offset += sizeof(address.page);
+                memcpy(&address.offset, data.data() + offset, sizeof(address.offset));
+                offset += sizeof(address.offset);
+            }
+        }
+        else{
+            node.children.resize(count + 1);
+            memcpy(node.children.data(), data.data() + offset, (count + 1) * sizeof(Page));
+        }
+        return node;
+    }
+};
+
+// Unsigned LEB128 varints and little endian bit fields of the compact node encoding
+inline size_t varintSize(uint64_t value){
+    size_t bytes = 1;
+    for(; value >= 0x80; value >>= 7){
+        bytes++;
+    }
+    return bytes;
+}
+
+inline void putVarint(Byte *&out, uint64_t value){
+    for(; value >= 0x80; value >>= 7){
+        *out++ = (Byte)(value | 0x80);
+    }
+    *out++ = (Byte)value;
+}
+
+inline uint64_t getVarint(const Byte *&in){
+    uint64_t value = 0;
+    for(int shift = 0; ; shift += 7){
+        Byte byte = *in++;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if(byte < 0x80){
+            return value;
+        }
+    }
+}
+
+inline int bitsFor(uint64_t value){
+    int bits = 0;
+    for(; value != 0; value >>= 1){
+        bits++;
+    }
+    return bits;
+}
+
+// Writes the low bits of value at bit offset bit of out, which must be zeroed
+inline void putBits(Byte *out, size_t &bit, uint64_t value, int bits){
+    for(int i = 0; i < bits; i++, bit++){
+        if(value >> i & 1){
+            out[bit / 8] |= (Byte)(1 << bit % 8);
+        }
+    }
+}
+
+inline uint64_t getBits(const Byte *in, size_t &bit, int bits){
+    uint64_t value = 0;
+    for(int i = 0; i < bits; i++, bit++){
+        value |= (uint64_t)(in[bit / 8] >> bit % 8 & 1) << i;
+    }
+    return value;
+}
+
+// Node of the B+-tree over long long keys with a compact page encoding, filled by bytes instead of by
+// key count. The first key is a zigzag varint and every other key the varint of its distance to the
+// previous one. Record pages, record offsets and children are stored relative to their smallest
+// value, bit packed with as many bits as the largest difference needs.
+template <size_t PageBytes>
+struct BPlusNode<PageBytes, Key, less<Key>, COMPACT_NODES>{
+    bool leaf = false;
+    Page prev = NULL_PAGE;
+    Page next = NULL_PAGE;
+    vector<Key> keys;
+    vector<Address> addresses;
+    vector<Page> children;
+
+    static const size_t HEADER_SIZE = sizeof(bool) + sizeof(int) + 2 * sizeof(Page);
+    static const size_t MIN_SIZE = PageBytes / 2;
+    static const size_t size = PageBytes;
+    static const int FORMAT = -3;
+
+    static_assert(PageBytes % SECTOR_SIZE == 0, "BPlusNode: page size must be a multiple of SECTOR_SIZE");
+
+    static const size_t LEAF_OFFSET = 0;
+    static const size_t COUNT_OFFSET = LEAF_OFFSET + sizeof(bool);
+    static const size_t PREV_OFFSET = COUNT_OFFSET + sizeof(int);
+    static const size_t NEXT_OFFSET = PREV_OFFSET + sizeof(Page);
+
+    // Smallest of a run of values and the bits their differences to it need
+    struct Frame{
+        uint32_t base = 0;
+        int bits = 0;
+
+        template <typename Get>
+        static Frame of(int count, Get get){
+            Frame frame;
+            if(count == 0){
+                return frame;
+            }
+            uint32_t low = get(0), high = get(0);
+            for(int i = 1; i < count; i++){
+                low = min(low, (uint32_t)get(i));
+                high = max(high, (uint32_t)get(i));
+            }
+            frame.base = low;
+            frame.bits = bitsFor(high - low);
+            return frame;
+        }
+
+        size_t bytes() const{
+            return varintSize(base) + 1;
+        }
+
+        void write(Byte *&out) const{
+            putVarint(out, base);
+            *out++ = (Byte)bits;
+        }
+
+        static Frame read(const Byte *&in){
+            Frame frame;
+            frame.base = (uint32_t)getVarint(in);
+            frame.bits = *in++;
+            return frame;
+        }
+    };
+
+    static uint64_t zigzag(Key key){
+        return ((uint64_t)key << 1) ^ (uint64_t)(key >> 63);
+    }
+
+    static Key unzigzag(uint64_t value){
+        return (Key)(value >> 1) ^ -(Key)(value & 1);
+    }
+
+    static uint64_t delta(const Key *keys, int i){
+        return i == 0 ? zigzag(keys[0]) : (uint64_t)keys[i] - (uint64_t)keys[i - 1];
+    }
+
+    static bool equal(Key a, Key b){
+        return a == b;
+    }
+
+    static Key separator(Key, Key high){
+        return high;
+    }
+
+    static void checkKey(Key){}
+
+    // Bytes a node with count keys and their addresses, or count + 1 children, takes on its page
+    static size_t encodedSize(bool leaf, const Key *keys, int count, const Address *addresses, const Page *children){
+        size_t bytes = HEADER_SIZE;
+        for(int i = 0; i < count; i++){
+            bytes += varintSize(delta(keys, i));
+        }
+        if(leaf){
+            Frame pages = Frame::of(count, [addresses](int i){ return addresses[i].page; });
+            Frame offsets = Frame::of(count, [addresses](int i){ return addresses[i].offset; });
+            bytes += pages.bytes() + offsets.bytes() + (count * (pages.bits + offsets.bits) + 7) / 8;
+        }
+        else{
+            Frame pages = Frame::of(count + 1, [children](int i){ return children[i]; });
+            bytes += pages.bytes() + ((count + 1) * pages.bits + 7) / 8;
+        }
+        return bytes;
+    }
+
+    size_t encodedSize() const{
+        return encodedSize(leaf, keys.data(), (int)keys.size(), addresses.data(), children.data());
+    }
+
+    bool overflows() const{
+        return encodedSize() > PageBytes;
+    }
+
+    bool underflows() const{
+        return encodedSize() < MIN_SIZE;
+    }
+
+    bool splitFits(int point) const{
+        int count = (int)keys.size();
+        if(leaf){
+            return encodedSize(true, keys.data(), point, addresses.data(), nullptr) <= PageBytes &&
+                encodedSize(true, keys.data() + point, count - point, addresses.data() + point, nullptr) <= PageBytes;
+        }
+        return encodedSize(false, keys.data(), point, nullptr, children.data()) <= PageBytes &&
+            encodedSize(false, keys.data() + point + 1, count - point - 1, nullptr, children.data() + point + 1) <= PageBytes;
+    }
+
+    int splitPoint() const{
+        int point = leaf ? (int)(keys.size() + 1) / 2 : (int)keys.size() / 2;
+        return nearestSplit(point, (int)keys.size(), leaf, [this](int point){ return splitFits(point); });
+    }
+
+    pair<int, int> usage() const{
+        return {(int)encodedSize(), (int)PageBytes};
+    }
+
+    int searchPlace(Key key) const{
+        return rankSearch((const Byte*)keys.data(), (int)keys.size(), key);
+    }
+
+    int lowerBound(Key key) const{
+        return lower_bound(keys.begin(), keys.end(), key) - keys.begin();
+    }
+
+    int searchChild(Page page) const{
+        for(int i = 0; i < (int)children.size(); i++){
+            if(children[i] == page){
+                return i;
+            }
+        }
+        return NULL_PAGE;
+    }
+
+    Data serialize() const{
+        if(overflows()){
+            throw logic_error("BPlusNode: node of " + to_string(encodedSize()) + " bytes does not fit a page");
+        }
+        Data data(size, 0);
+        int count = (int)keys.size();
+
+        memcpy(data.data() + LEAF_OFFSET, &leaf, sizeof(leaf));
+        memcpy(data.data() + COUNT_OFFSET, &count, sizeof(count));
+        memcpy(data.data() + PREV_OFFSET, &prev, sizeof(prev));
+        memcpy(data.data() + NEXT_OFFSET, &next, sizeof(next));
+
+        Byte *out = data.data() + HEADER_SIZE;
+        for(int i = 0; i < count; i++){
+            putVarint(out, delta(keys.data(), i));
+        }
+
+        size_t bit = 0;
+        if(leaf){
+            Frame pages = Frame::of(count, [this](int i){ return addresses[i].page; });
+            Frame offsets = Frame::of(count, [this](int i){ return addresses[i].offset; });
+            pages.write(out);
+            offsets.write(out);
+            for(const Address &address : addresses){
+                putBits(out, bit, (uint32_t)address.page - pages.base, pages.bits);
+                putBits(out, bit, (uint32_t)address.offset - offsets.base, offsets.bits);
+            }
+        }
+        else{
+            Frame pages = Frame::of(count + 1, [this](int i){ return children[i]; });
+            pages.write(out);
+            for(Page child : children){
+                putBits(out, bit, (uint32_t)child - pages.base, pages.bits);
+            }
+        }
+        return data;
+    }
+
+    static BPlusNode deserialize(const Data &data){
+        BPlusNode node;
+        int count;
+
+        memcpy(&node.leaf, data.data() + LEAF_OFFSET, sizeof(node.leaf));
+        memcpy(&count, data.data() + COUNT_OFFSET, sizeof(count));
+        memcpy(&node.prev, data.data() + PREV_OFFSET, sizeof(node.prev));
+        memcpy(&node.next, data.data() + NEXT_OFFSET, sizeof(node.next));
+
+        const Byte *in = data.data() + HEADER_SIZE;
+        node.keys.resize(count);
+        for(int i = 0; i < count; i++){
+            uint64_t value = getVarint(in);
+            node.keys[i] = i == 0 ? unzigzag(value) : (Key)((uint64_t)node.keys[i - 1] + value);
+        }
+
+        size_t bit = 0;
+        if(node.leaf){
+            Frame pages = Frame::read(in);
+            Frame offsets = Frame::read(in);
+            node.addresses.resize(count);
+            for(Address &address : node.addresses){
+                address.page = (Page)(pages.base + (uint32_t)getBits(in, bit, pages.bits));
+                address.offset = (int)(offsets.base + (uint32_t)getBits(in, bit, offsets.bits));
+            }
+        }
+        else{
+            Frame pages = Frame::read(in);
+            node.children.resize(count + 1);
+            for(Page &child : node.children){
+                child = (Page)(pages.base + (uint32_t)getBits(in, bit, pages.bits));
+            }
+        }
+        return node;
+    }
+};
@@ -0,0 +1,547 @@
+#pragma once
+#include "bplus_node.h"
+#include "record.h"
+#include "buffer_manager.h"
+#include <memory>
+
+// B+-tree over the same disk, buffer and record heap layers as BTree, so both can run the same traces.
+// Keys are of type K ordered by Compare, string keys and COMPACT_NODES get nodes filled by bytes, see BPlusNode.
+template <typename T, size_t PageBytes = Node<DEFAULT_ORDER>::size, typename K = Key, typename Compare = less<K>,
+    NODE_ENCODING Encoding = PLAIN_NODES>
+class BPlusTree{
+    using Node = BPlusNode<PageBytes, K, Compare, Encoding>;
+
+    static_assert(is_same<decltype(T::key), K>::value, "BPlusTree: record key must be of the key type");
+
+    static const int BPLUS_ORDER = Node::FORMAT;
+
+    Page root;
+    DiskManager diskNodes;
+    DiskManager diskMain;
+    BufferManager bufferNodes;
+    BufferManager bufferRecords;
+
+    Node readNode(Page page){
+        return Node::deserialize(bufferNodes.readPage(page));
+    }
+
+    void writeNode(Page page, const Node &node){
+        bufferNodes.writePage(page, node.serialize());
+    }
+
+    void setPrev(Page page, Page prev){
+        if(page != NULL_PAGE){
+            PageGuard guard = bufferNodes.pinForWrite(page);
+            memcpy(guard.write().data() + Node::PREV_OFFSET, &prev, sizeof(prev));
+        }
+    }
+
+    // Descends from the root to the leaf that may contain key, appending every visited page to path
+    Node findLeaf(const K &key, vector<Page> &path){
+        Page page = root;
+        while(true){
+            path.push_back(page);
+            Node node = readNode(page);
+            if(node.leaf){
+                return node;
+            }
+            page = node.children[node.searchPlace(key)];
+        }
+    }
+
+    Page leftmostLeaf(){
+        Page page = root;
+        while(true){
+            Node node = readNode(page);
+            if(node.leaf){
+                return page;
+            }
+            page = node.children[0];
+        }
+    }
+
+    optional<Address> find(const K &key){
+        vector<Page> path;
+        Node leaf = findLeaf(key, path);
+        int index = leaf.lowerBound(key);
+        if(index < (int)leaf.keys.size() && Node::equal(leaf.keys[index], key)){
+            return leaf.addresses[index];
+        }
+        return nullopt;
+    }
+
+    // Splits an overflowing node into itself and a new right sibling, returns the separator for the parent
+    K split(Node &node, Page page, Page &newPage){
+        Node sibling;
+        sibling.leaf = node.leaf;
+        newPage = diskNodes.allocatePage();
+        K separator;
+
+        if(node.leaf){
+            int half = node.splitPoint();
+            sibling.keys.assign(node.keys.begin() + half, node.keys.end());
+            sibling.addresses.assign(node.addresses.begin() + half, node.addresses.end());
+            node.keys.resize(half);
+            node.addresses.resize(half);
+
+            sibling.prev = page;
+            sibling.next = node.next;
+            setPrev(node.next, newPage);
+            node.next = newPage;
+            separator = Node::separator(node.keys.back(), sibling.keys[0]);
+        }
+        else{
+            int middle = node.splitPoint();
+            separator = node.keys[middle];
+            sibling.keys.assign(node.keys.begin() + middle + 1, node.keys.end());
+            sibling.children.assign(node.children.begin() + middle + 1, node.children.end());
+            node.keys.resize(middle);
+            node.children.resize(middle + 1);
+        }
+
+        writeNode(page, node);
+        writeNode(newPage, sibling);
+        return separator;
+    }
+
+    // Moves the last key of left into node through the parent, unless that leaves left underfull or
+    // node larger than a page
+    bool borrowFromLeft(Node &node, Node &left, Node &parent, int separator){
+        if(left.keys.size() < 2){
+            return false;
+        }
+        Node receiver = node, lender = left;
+        K newSeparator;
+        if(node.leaf){
+            receiver.keys.insert(receiver.keys.begin(), lender.keys.back());
+            receiver.addresses.insert(receiver.addresses.begin(), lender.addresses.back());
+            lender.addresses.pop_back();
+            newSeparator = Node::separator(lender.keys[lender.keys.size() - 2], lender.keys.back());
+        }
+        else{
+            receiver.keys.insert(receiver.keys.begin(), parent.keys[separator]);
+            receiver.children.insert(receiver.children.begin(), lender.children.back());
+            lender.children.pop_back();
+            newSeparator = lender.keys.back();
+        }
+        lender.keys.pop_back();
+
+        if(lender.underflows() || receiver.overflows()){
+            return false;
+        }
+        node = move(receiver);
+        left = move(lender);
+        parent.keys[separator] = newSeparator;
+        return true;
+    }
+
+    // Moves the first key of right into node through the parent, under the same conditions as borrowFromLeft
+    bool borrowFromRight(Node &node, Node &right, Node &parent, int separator){
+        if(right.keys.size() < 2){
+            return false;
+        }
+        Node receiver = node, lender = right;
+        K newSeparator;
+        if(node.leaf){
+            receiver.keys.push_back(lender.keys.front());
+            receiver.addresses.push_back(lender.addresses.front());
+            lender.keys.erase(lender.keys.begin());
+            lender.addresses.erase(lender.addresses.begin());
+            newSeparator = Node::separator(receiver.keys.back(), lender.keys.front());
+        }
+        else{
+            receiver.keys.push_back(parent.keys[separator]);
+            receiver.children.push_back(lender.children.front());
+            newSeparator = lender.keys.front();
+            lender.keys.erase(lender.keys.begin());
+            lender.children.erase(lender.children.begin());
+        }
+
+        if(lender.underflows() || receiver.overflows()){
+            return false;
+        }
+        node = move(receiver);
+        right = move(lender);
+        parent.keys[separator] = newSeparator;
+        return true;
+    }
+
+    // Moves everything from right into left and drops the separator between them from the parent,
+    // unless the merged node does not fit a page
+    bool merge(Node &left, Page leftPage, Node &right, Page rightPage, Node &parent, int separator){
+        Node merged = left;
+        if(left.leaf){
+            merged.keys.insert(merged.keys.end(), right.keys.begin(), right.keys.end());
+            merged.addresses.insert(merged.addresses.end(), right.addresses.begin(), right.addresses.end());
+            merged.next = right.next;
+        }
+        else{
+            merged.keys.push_back(parent.keys[separator]);
+            merged.keys.insert(merged.keys.end(), right.keys.begin(), right.keys.end());
+            merged.children.insert(merged.children.end(), right.children.begin(), right.children.end());
+        }
+        if(merged.overflows()){
+            return false;
+        }
+        if(left.leaf){
+            setPrev(right.next, leftPage);
+        }
+        left = move(merged);
+        parent.keys.erase(parent.keys.begin() + separator);
+        parent.children.erase(parent.children.begin() + separator + 1);
+
+        bufferNodes.removePage(rightPage);
+        writeNode(leftPage, left);
+        return true;
+    }
+
+    // Writes node back to page, splitting it and its ancestors on path for as long as they overflow
+    void splitUp(Node &node, Page page, vector<Page> &path){
+        while(node.overflows()){
+            Page newPage;
+            K separator = split(node, page, newPage);
+            if(path.empty()){
+                Node newRoot;
+                newRoot.keys.push_back(separator);
+                newRoot.children = {page, newPage};
+                root = bufferNodes.writePage(newRoot.serialize());
+                return;
+            }
+            page = path.back();
+            path.pop_back();
+            node = readNode(page);
+            int place = node.searchPlace(separator);
+            node.keys.insert(node.keys.begin() + place, separator);
+            node.children.insert(node.children.begin() + place + 1, newPage);
+        }
+        writeNode(page, node);
+    }
+
+    pair<int, int> getRatio(Page page){
+        Node node = Node::deserialize(bufferNodes.peekPage(page));
+        pair<int, int> answer = node.usage();
+        bufferNodes.prefetch(node.children);
+        for(Page child : node.children){
+            pair<int, int> ans = getRatio(child);
+            answer.first += ans.first;
+            answer.second += ans.second;
+        }
+        return answer;
+    }
+
+public:
+    // Forward cursor over the records with keys in [lo, hi], walking the linked leaves, a missing bound
+    // leaves that side open. The tree must not be modified while a cursor is in use.
+    class Cursor{
+        BPlusTree* tree;
+        optional<K> hi;
+        Page leafPage = NULL_PAGE;
+        int index = 0;
+        vector<T> batch;
+        int position = 0;
+        // The next leaf, read one batch early so the record pages it points to are hinted while this batch is read
+        optional<Node> ahead;
+
+        bool inRange(const K &key) const{
+            return hi == nullopt || !Compare()(*hi, key);
+        }
+
+        void readAhead(){
+            ahead = tree->readNode(leafPage);
+            vector<Page> pages;
+            for(int i = 0; i < (int)ahead->keys.size() && inRange(ahead->keys[i]); i++){
+                pages.push_back(ahead->addresses[i].page);
+            }
+            tree->bufferRecords.prefetch(pages);
+        }
+
+        void fillBatch(){
+            vector<Address> addresses;
+            while(addresses.empty() && leafPage != NULL_PAGE){
+                Node leaf = ahead != nullopt ? move(*ahead) : tree->readNode(leafPage);
+                ahead = nullopt;
+                for(; index < (int)leaf.keys.size() && inRange(leaf.keys[index]); index++){
+                    addresses.push_back(leaf.addresses[index]);
+                }
+                if(index < (int)leaf.keys.size()){
+                    leafPage = NULL_PAGE;
+                }
+                else{
+                    leafPage = leaf.next;
+                    index = 0;
+                    if(!addresses.empty() && leafPage != NULL_PAGE){
+                        readAhead();
+                    }
+                }
+            }
+            batch.clear();
+            position = 0;
+            for(const Data &data : tree->bufferRecords.readRecords(addresses)){
+                batch.push_back(T::deserialize(data));
+            }
+        }
+
+    public:
+        Cursor(BPlusTree *tree, const optional<K> &lo, const optional<K> &hi) : tree(tree), hi(hi){
+            if(tree->root == NULL_PAGE || (lo != nullopt && hi != nullopt && Compare()(*hi, *lo))){
+                return;
+            }
+            if(lo == nullopt){
+                leafPage = tree->leftmostLeaf();
+                return;
+            }
+            vector<Page> path;
+            Node leaf = tree->findLeaf(*lo, path);
+            leafPage = path.back();
+            index = leaf.lowerBound(*lo);
+        }
+
+        optional<T> next(){
+            if(position == (int)batch.size()){
+                fillBatch();
+                if(batch.empty()){
+                    return nullopt;
+                }
+            }
+            return batch[position++];
+        }
+    };
+
+    // With reopen the tree is attached to files written by an earlier instance instead of starting empty,
+    // io picks how both files are read and written
+    BPlusTree(const string &nodesFile = "../data/bplus_nodes.txt", const string &recordsFile = "../data/bplus_records.txt", bool reopen = false,
+        IO_BACKEND io = DEFAULT_IO_BACKEND) :
+        diskNodes(nodesFile, Node::size, reopen, true, io),
+        diskMain(recordsFile, T::size * BLOCKING_FACTOR, T::size, reopen, true, io),
+
+        bufferNodes(&diskNodes, NODES_CACHE_SIZE),
+        bufferRecords(&diskMain, RECORDS_CACHE_SIZE, T::size)
+    {
+        root = NULL_PAGE;
+        if(reopen){
+            if(diskNodes.superblock().order != BPLUS_ORDER){
+                throw std::runtime_error("BPlusTree: " + nodesFile + " does not hold a B+-tree");
+            }
+            root = diskNodes.superblock().root;
+        }
+    }
+
+    static unique_ptr<BPlusTree> open(const string &directory, IO_BACKEND io = DEFAULT_IO_BACKEND){
+        return make_unique<BPlusTree>(directory + "/bplus_nodes.txt", directory + "/bplus_records.txt", true, io);
+    }
+
+    ~BPlusTree(){
+        close();
+    }
+
+    // Flushes cached pages and stores the root in the superblock, also done on destruction
+    void close(){
+        bufferNodes.flush();
+        bufferRecords.flush();
+        diskNodes.storeRoot(root, BPLUS_ORDER);
+        diskNodes.sync();
+        diskMain.sync();
+    }
+
+    optional<T> search(const K &key){
+        if(root == NULL_PAGE){
+            return nullopt;
+        }
+        auto result = find(key);
+        if(result == nullopt){
+            return nullopt;
+        }
+        return T::deserialize(bufferRecords.readRecord(*result));
+    }
+
+    // Where new records are stored in the record file, FIRST_FIT by default
+    void setPlacement(PLACEMENT placement){
+        bufferRecords.setPlacement(placement);
+    }
+
+    // Applies to the node and the record caches separately, LRU_POLICY by default
+    void setReplacement(REPLACEMENT nodes, REPLACEMENT records){
+        bufferNodes.setReplacement(nodes);
+        bufferRecords.setReplacement(records);
+    }
+
+    // Dirty pages evicted together from each cache, see BufferManager::setEvictionBatch
+    void setEvictionBatch(int pages){
+        bufferNodes.setEvictionBatch(pages);
+        bufferRecords.setEvictionBatch(pages);
+    }
+
+    // Keeps the frames coldest pages of each cache clean from a background thread, 0 stops it
+    void setCleaner(int frames){
+        bufferNodes.setCleaner(frames);
+        bufferRecords.setCleaner(frames);
+    }
+
+    // Pages written back by evictions and by the cleaners of both caches
+    WriteBackStats getWriteBackStats(){
+        WriteBackStats nodes = bufferNodes.getWriteBackStats();
+        WriteBackStats records = bufferRecords.getWriteBackStats();
+        return {nodes.foreground + records.foreground, nodes.background + records.background};
+    }
+
+    IOStats getNodeStats(){
+        return diskNodes.stats;
+    }
+
+    IOStats getRecordStats(){
+        return diskMain.stats;
+    }
+
+    STATUS modify(T &record){
+        if(root == NULL_PAGE){
+            return DOESNT_EXIST;
+        }
+        auto result = find(record.key);
+        if(result == nullopt){
+            return DOESNT_EXIST;
+        }
+
+        bufferRecords.writeRecord(*result, record.serialize());
+
+        return OK;
+    }
+
+    STATUS insert(T &record){
+        Node::checkKey(record.key);
+        if(root == NULL_PAGE){
+            Node node;
+            node.leaf = true;
+            node.keys.push_back(record.key);
+            node.addresses.push_back(bufferRecords.writeRecord(record.serialize()));
+            root = bufferNodes.writePage(node.serialize());
+            return OK;
+        }
+
+        vector<Page> path;
+        Node node = findLeaf(record.key, path);
+        int index = node.lowerBound(record.key);
+        if(index < (int)node.keys.size() && Node::equal(node.keys[index], record.key)){
+            return ALREADY_EXISTS;
+        }
+        Page neighbour = node.addresses[max(index - 1, 0)].page;
+        node.keys.insert(node.keys.begin() + index, record.key);
+        node.addresses.insert(node.addresses.begin() + index, bufferRecords.writeRecord(record.serialize(), neighbour));
+
+        Page page = path.back();
+        path.pop_back();
+        splitUp(node, page, path);
+        return OK;
+    }
+
+    STATUS remove(const K &key){
+        if(root == NULL_PAGE){
+            return DOESNT_EXIST;
+        }
+
+        vector<Page> path;
+        Node node = findLeaf(key, path);
+        int index = node.lowerBound(key);
+        if(index == (int)node.keys.size() || !Node::equal(node.keys[index], key)){
+            return DOESNT_EXIST;
+        }
+        bufferRecords.removeRecord(node.addresses[index]);
+        node.keys.erase(node.keys.begin() + index);
+        node.addresses.erase(node.addresses.begin() + index);
+
+        Page page = path.back();
+        while(true){
+            if(page == root){
+                if(node.keys.empty()){
+                    bufferNodes.removePage(page);
+                    root = node.leaf ? NULL_PAGE : node.children[0];
+                }
+                else{
+                    writeNode(page, node);
+                }
+                break;
+            }
+            if(!node.underflows()){
+                writeNode(page, node);
+                break;
+            }
+
+            path.pop_back();
+            Page parentPage = path.back();
+            Node parent = readNode(parentPage);
+            int childIndex = parent.searchChild(page);
+
+            Page leftPage = childIndex > 0 ? parent.children[childIndex - 1] : NULL_PAGE;
+            Page rightPage = childIndex + 1 < (int)parent.children.size() ? parent.children[childIndex + 1] : NULL_PAGE;
+            Node left, right;
+
+            if(leftPage != NULL_PAGE){
+                left = readNode(leftPage);
+                if(borrowFromLeft(node, left, parent, childIndex - 1)){
+                    writeNode(leftPage, left);
+                    writeNode(page, node);
+                    path.pop_back();
+                    splitUp(parent, parentPage, path);
+                    break;
+                }
+            }
+            if(rightPage != NULL_PAGE){
+                right = readNode(rightPage);
+                if(borrowFromRight(node, right, parent, childIndex)){
+                    writeNode(rightPage, right);
+                    writeNode(page, node);
+                    path.pop_back();
+                    splitUp(parent, parentPage, path);
+                    break;
+                }
+            }
+
+            bool merged = leftPage != NULL_PAGE && merge(left, leftPage, node, page, parent, childIndex - 1);
+            if(!merged && rightPage != NULL_PAGE){
+                merged = merge(node, page, right, rightPage, parent, childIndex);
+            }
+            // Nodes filled by bytes may not fit with either sibling, the node then stays underfull
+            if(!merged){
+                writeNode(page, node);
+                break;
+            }
+            page = parentPage;
+            node = move(parent);
+        }
+        return OK;
+    }
+
+    Cursor scan(const K &lo, const K &hi){
+        return Cursor(this, lo, hi);
+    }
+
+    void printAll(){
+        Cursor cursor(this, nullopt, nullopt);
+        while(optional<T> record = cursor.next()){
+            record->print();
+            cout << "\n";
+        }
+    }
+
+    double getRatio(){
+        if(root == NULL_PAGE){
+            return 0;
+        }
+        auto [keys, capacity] = getRatio(root);
+        return (double)keys / capacity;
+    }
+
+    int getHeight(){
+        int height = 0;
+        Page page = root;
+        while(page != NULL_PAGE){
+            height++;
+            Node node = Node::deserialize(bufferNodes.peekPage(page));
+            page = node.leaf ? NULL_PAGE : node.children[0];
+        }
+        return height;
+    }
+};
+
+// B+-tree over long long keys whose nodes are delta and bit packed, e.g. CompactBPlusTree<Record, 4096>
+template <typename T, size_t PageBytes = Node<DEFAULT_ORDER>::size>
+using CompactBPlusTree = BPlusTree<T, PageBytes, Key, less<Key>, COMPACT_NODES>;
@@ -2,67 +2,268 @@
 #include "node.h"
 #include "record.h"
 #include "buffer_manager.h"
-
-struct SearchResult{
-    STATUS status;
-    Page page;
-};
-
-template <typename T>
+#include "optimistic_latch.h"
+#include "wal.h"
+#include <limits>
+#include <memory>
+#include <atomic>
+#include <shared_mutex>
+#include <tuple>
+
+template <typename T, int D = DEFAULT_ORDER>
 class BTree{
-    
-    Page root;
+    using Node = ::Node<D>;
+
+    atomic<Page> root;
     DiskManager diskNodes;
     DiskManager diskMain;
     BufferManager bufferNodes;
     BufferManager bufferRecords;
 
-    void updateChildParent(Page childPageID, Page newParentID) {
-        Node childNode = Node::deserialize(bufferNodes.readPage(childPageID));
-        childNode.parent = newParentID;
-        bufferNodes.writePage(childPageID, childNode.serialize());
+    // Version latches of the root pointer and of every node page
+    OptimisticLatch rootLatch;
+    LatchTable latches;
+
+    // Redo log of node and record writes, null when the tree is not logged
+    unique_ptr<WriteAheadLog> wal;
+    // Writers share it for the length of an operation, a checkpoint takes it exclusively
+    shared_mutex checkpointLock;
+    enum LOG_TARGET { LOG_NODES, LOG_RECORDS };
+
+    using View = NodeView<D>;
+
+    // What a writer may do to the nodes on its path, decides when their ancestors are safe to release
+    enum WRITE_MODE { WRITE_MODIFY, WRITE_INSERT, WRITE_REMOVE };
+
+    Page parentOf(const vector<Page> &path){
+        return path.size() > 1 ? path[path.size() - 2] : NULL_PAGE;
     }
 
-    optional<Address> search(Key key, Page page){
-        Node node = Node::deserialize(bufferNodes.readPage(page));
-        int index = node.searchPlace({key, {0, 0}});
-        if(index > 0 && node.entries[index - 1].key == key){
-            return node.entries[index - 1].address;
+    // A safe node absorbs the change below it, no split or merge reaches its ancestors
+    bool isSafe(int count, bool isRoot, WRITE_MODE mode){
+        if(mode == WRITE_INSERT){
+            return count < Node::MAX_ENTRIES;
         }
-        if(node.leaf){
-            return nullopt;
+        if(mode == WRITE_REMOVE){
+            return count > (isRoot ? 1 : Node::MIN_ENTRIES);
         }
-        return search(key, node.children[index]);
+        return true;
     }
 
-    SearchResult searchPlace(Key key, Page page){
-        Node node = Node::deserialize(bufferNodes.readPage(page));
-        int index = node.searchPlace({key, {0, 0}});
+    // One optimistic descent without latches, every node read is validated against the version seen before reading it.
+    // Returns false when a writer changed a visited node in the meantime and the search has to start over.
+    // Removing from an inner node pulls its successor up from a leaf, past readers already below it, so a miss
+    // is only reported once the whole path is still unchanged.
+    bool trySearch(Key key, optional<T> &result){
+        uint64_t rootVersion = rootLatch.readLock();
+        Page page = root;
+        if(page == NULL_PAGE){
+            result = nullopt;
+            return rootLatch.validate(rootVersion);
+        }
+        uint64_t version = latches[page].readLock();
+        if(!rootLatch.validate(rootVersion)){
+            return false;
+        }
+        vector<pair<Page, uint64_t>> visited;
 
-        if(index > 0 && node.entries[index - 1].key == key){
-            return {ALREADY_EXISTS, page};
+        while(true){
+            visited.push_back({page, version});
+            bool found;
+            bool leaf;
+            Address address;
+            Page child = NULL_PAGE;
+            try{
+                PageGuard guard = bufferNodes.pin(page);
+                View node(guard.bytes());
+                int index = node.searchPlace(key);
+                found = index > 0 && node.key(index - 1) == key;
+                leaf = node.leaf();
+                if(found){
+                    address = node.address(index - 1);
+                }
+                else if(!leaf){
+                    child = node.child(index);
+                }
+            }
+            catch(const std::runtime_error&){
+                // The page was freed after its version was read
+                if(latches[page].validate(version)){
+                    throw;
+                }
+                return false;
+            }
+            if(!latches[page].validate(version)){
+                return false;
+            }
+
+            if(found){
+                Data data = bufferRecords.readRecord(address);
+                if(!latches[page].validate(version)){
+                    return false;
+                }
+                result = T::deserialize(data);
+                return true;
+            }
+            if(leaf){
+                if(!rootLatch.validate(rootVersion)){
+                    return false;
+                }
+                for(auto &[visitedPage, visitedVersion] : visited){
+                    if(!latches[visitedPage].validate(visitedVersion)){
+                        return false;
+                    }
+                }
+                result = nullopt;
+                return true;
+            }
+            uint64_t childVersion = latches[child].readLock();
+            if(!latches[page].validate(version)){
+                return false;
+            }
+            page = child;
+            version = childVersion;
         }
-        if(node.leaf){
-            return {DOESNT_EXIST, page};
+    }
+
+    // Optimistic walk of the subtree at page for the probes keys[order[first]], ..., keys[order[last - 1]], which are
+    // sorted. Probes below the same child go down together, the children are visited in key order. Addresses of
+    // found keys are appended with the probe they answer to owners, every node read is appended to visited.
+    bool trySearchMany(const vector<Key> &keys, const vector<int> &order, int first, int last, Page page, uint64_t version,
+        vector<pair<Page, uint64_t>> &visited, vector<Address> &addresses, vector<int> &owners){
+        visited.push_back({page, version});
+        // Child pages with the range of probes that go down into them
+        vector<tuple<Page, int, int>> runs;
+        try{
+            PageGuard guard = bufferNodes.pin(page);
+            View node(guard.bytes());
+            bool leaf = node.leaf();
+            for(int i = first; i < last; i++){
+                Key key = keys[order[i]];
+                int index = node.searchPlace(key);
+                if(index > 0 && node.key(index - 1) == key){
+                    addresses.push_back(node.address(index - 1));
+                    owners.push_back(order[i]);
+                }
+                else if(!leaf){
+                    Page child = node.child(index);
+                    if(runs.empty() || get<0>(runs.back()) != child){
+                        runs.push_back({child, i, i + 1});
+                    }
+                    else{
+                        get<2>(runs.back()) = i + 1;
+                    }
+                }
+            }
+        }
+        catch(const std::runtime_error&){
+            // The page was freed after its version was read
+            if(latches[page].validate(version)){
+                throw;
+            }
+            return false;
+        }
+        if(!latches[page].validate(version)){
+            return false;
+        }
+
+        vector<Page> children;
+        for(auto &[child, from, to] : runs){
+            children.push_back(child);
+        }
+        bufferNodes.prefetch(children);
+        for(auto &[child, from, to] : runs){
+            uint64_t childVersion = latches[child].readLock();
+            if(!latches[page].validate(version)){
+                return false;
+            }
+            if(!trySearchMany(keys, order, from, to, child, childVersion, visited, addresses, owners)){
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // One optimistic walk for all probes, the records found are read grouped by page. Like trySearch it returns
+    // false when a writer changed a visited node before the whole walk and its records were read.
+    bool trySearchMany(const vector<Key> &keys, vector<optional<T>> &results){
+        vector<int> order(keys.size());
+        for(int i = 0; i < (int)order.size(); i++){
+            order[i] = i;
+        }
+        sort(order.begin(), order.end(), [&keys](int a, int b){
+            return keys[a] < keys[b];
+        });
+
+        results.assign(keys.size(), nullopt);
+        uint64_t rootVersion = rootLatch.readLock();
+        Page page = root;
+        if(page == NULL_PAGE || keys.empty()){
+            return rootLatch.validate(rootVersion);
+        }
+        uint64_t version = latches[page].readLock();
+        if(!rootLatch.validate(rootVersion)){
+            return false;
+        }
+
+        vector<pair<Page, uint64_t>> visited;
+        vector<Address> addresses;
+        vector<int> owners;
+        if(!trySearchMany(keys, order, 0, (int)order.size(), page, version, visited, addresses, owners)){
+            return false;
+        }
+        vector<Data> records = bufferRecords.readRecords(addresses);
+        if(!rootLatch.validate(rootVersion)){
+            return false;
+        }
+        for(auto &[visitedPage, visitedVersion] : visited){
+            if(!latches[visitedPage].validate(visitedVersion)){
+                return false;
+            }
+        }
+        for(int i = 0; i < (int)records.size(); i++){
+            results[owners[i]] = T::deserialize(records[i]);
         }
-        return searchPlace(key, node.children[index]);
+        return true;
     }
 
-    void leftRotate(Node &parent, Node &leftChild, Node &node, int parentIndex, Page leftPage){
+    // Descends from the root towards key with latch crabbing, appending every visited page to path.
+    // held keeps the latches of the pages a split or merge may still reach, the caller holds the root pointer.
+    STATUS searchPlace(Key key, WRITE_MODE mode, vector<Page> &path, WriteLatches &held){
+        Page page = root;
+        while(true){
+            held.lock(page);
+            path.push_back(page);
+            PageGuard guard = bufferNodes.pin(page);
+            View node(guard.bytes());
+            if(isSafe(node.count(), page == root, mode)){
+                held.releaseAncestors();
+            }
+            int index = node.searchPlace(key);
+
+            if(index > 0 && node.key(index - 1) == key){
+                return ALREADY_EXISTS;
+            }
+            if(node.leaf()){
+                return DOESNT_EXIST;
+            }
+            page = node.child(index);
+        }
+    }
+
+    void leftRotate(Node &parent, Node &leftChild, Node &node, int parentIndex){
         leftChild.entries.push_back(parent.entries[parentIndex]);
         if(!node.leaf){
             leftChild.children.push_back(node.children[0]);
-            updateChildParent(node.children[0], leftPage);
         }
         parent.entries[parentIndex] = node.entries[0];
         node.pop_front();
     }
 
-    void rightRotate(Node &parent, Node &rightChild, Node &node, int parentIndex, Page rightPage){
+    void rightRotate(Node &parent, Node &rightChild, Node &node, int parentIndex){
         rightChild.push_front(parent.entries[parentIndex]);
         if(!node.leaf){
             rightChild.push_front(node.children[node.children.size() - 1]);
-            updateChildParent(node.children[node.children.size() - 1], rightPage);
         } 
         parent.entries[parentIndex] = node.entries[node.entries.size() - 1];
         node.pop_back();
@@ -70,124 +271,162 @@ class BTree{
 
     void performCompensation(
         Node &node, Page page,
-        Node &sibling, Page siblingPage, int siblingIndex,
-        Node &parent, int parentIndex, bool isLeft
+        Node &sibling, Page siblingPage,
+        Node &parent, Page parentPage, int parentIndex, bool isLeft
     ){
         int rotations = abs((int)(node.entries.size() - sibling.entries.size())) / 2;
         for(int i = 0; i < rotations; i++){
             if(isLeft){
-                leftRotate(parent, sibling, node, parentIndex, siblingPage);
+                leftRotate(parent, sibling, node, parentIndex);
             }
             else{
-                rightRotate(parent, sibling, node, parentIndex, siblingPage);
+                rightRotate(parent, sibling, node, parentIndex);
             }
         }
         bufferNodes.writePage(siblingPage, sibling.serialize());
-        bufferNodes.writePage(node.parent, parent.serialize());
+        bufferNodes.writePage(parentPage, parent.serialize());
         bufferNodes.writePage(page, node.serialize());
     }
 
-    bool compensation(Node &node, Page page, bool insert){
-        if(node.parent == NULL_PAGE){
-            return false;
+    // An overflowing node of nodeSize entries can share them with a sibling that still fits half of both
+    bool canCompensate(int siblingSize, int nodeSize, bool insert){
+        if(insert){
+            return siblingSize < Node::MAX_ENTRIES && siblingSize + nodeSize <= 2 * Node::MAX_ENTRIES;
         }
-        Node parent = Node::deserialize(bufferNodes.readPage(node.parent));
-        int childIndex = parent.searchChild(page);
+        return siblingSize > Node::MIN_ENTRIES;
+    }
 
-        if(childIndex > 0){
+    // The parent is latched by the caller, a sibling is latched before it is inspected
+    bool compensation(Node &node, Page page, Page parentPage, bool insert, WriteLatches &held){
+        if(parentPage == NULL_PAGE){
+            return false;
+        }
+        PageGuard parentGuard = bufferNodes.pin(parentPage);
+        View parentView(parentGuard.bytes());
+        int childIndex = parentView.searchChild(page);
+        int lastIndex = parentView.count();
+        Page leftSiblingPage = childIndex > 0 ? parentView.child(childIndex - 1) : NULL_PAGE;
+        Page rightSiblingPage = childIndex < lastIndex ? parentView.child(childIndex + 1) : NULL_PAGE;
+        parentGuard.release();
+
+        if(leftSiblingPage != NULL_PAGE){
             int leftIndex = childIndex - 1;
-            Page leftSiblingPage = parent.children[leftIndex];
-            Node leftSibling = Node::deserialize(bufferNodes.readPage(leftSiblingPage));
-            if(insert){
-                if(leftSibling.entries.size() < 2 * D){
-                    performCompensation(node, page, leftSibling, leftSiblingPage, leftIndex, parent, leftIndex, true);
-                    return true;
+            latches[leftSiblingPage].lock();
+            if(canCompensate(View(bufferNodes.pin(leftSiblingPage).bytes()).count(), (int)node.entries.size(), insert)){
+                held.adopt(leftSiblingPage);
+                Node leftSibling = Node::deserialize(bufferNodes.readPage(leftSiblingPage));
+                Node parent = Node::deserialize(bufferNodes.readPage(parentPage));
+                if(insert){
+                    performCompensation(node, page, leftSibling, leftSiblingPage, parent, parentPage, leftIndex, true);
                 }
-            }
-            else{
-                if(leftSibling.entries.size() > D){
-                    performCompensation(leftSibling, leftSiblingPage, node, page, childIndex, parent, leftIndex, false);
-                    return true;
+                else{
+                    performCompensation(leftSibling, leftSiblingPage, node, page, parent, parentPage, leftIndex, false);
                 }
+                return true;
             }
+            latches[leftSiblingPage].unlockUnchanged();
         }
-        if(childIndex < parent.children.size() - 1){
-            int rightIndex = childIndex + 1;
-            Page rightSibingPage = parent.children[rightIndex];
-            Node rightSibling = Node::deserialize(bufferNodes.readPage(rightSibingPage));
-            if(insert){
-                if(rightSibling.entries.size() < 2 * D){
-                    performCompensation(node, page, rightSibling, rightSibingPage, rightIndex, parent, childIndex, false);
-                    return true;
+        if(rightSiblingPage != NULL_PAGE){
+            latches[rightSiblingPage].lock();
+            if(canCompensate(View(bufferNodes.pin(rightSiblingPage).bytes()).count(), (int)node.entries.size(), insert)){
+                held.adopt(rightSiblingPage);
+                Node rightSibling = Node::deserialize(bufferNodes.readPage(rightSiblingPage));
+                Node parent = Node::deserialize(bufferNodes.readPage(parentPage));
+                if(insert){
+                    performCompensation(node, page, rightSibling, rightSiblingPage, parent, parentPage, childIndex, false);
                 }
-            }
-            else{
-                if(rightSibling.entries.size() > D){
-                    performCompensation(rightSibling, rightSibingPage, node, page, childIndex, parent, childIndex, true);
-                    return true;
+                else{
+                    performCompensation(rightSibling, rightSiblingPage, node, page, parent, parentPage, childIndex, true);
                 }
+                return true;
             }
+            latches[rightSiblingPage].unlockUnchanged();
         }
         return false;
     }
 
-    Node split(Node &node, Page page){ 
-        Node sibling;
-        sibling.leaf = node.leaf;
-
-        int median = D;
-        int maxEntries = 2 * D + 1;
-
-        for(int i = median + 1; i < maxEntries; i++){
-            sibling.entries.push_back(node.entries[i]);
-        }
-        if(!node.leaf){
-            for(int i = median + 1; i < maxEntries + 1; i++){
-                sibling.children.push_back(node.children[i]);
+    // Writes back the node at the end of path that took new entries. While it overflows it shares entries with a
+    // sibling, or is split and the entries moved up are taken by its parent.
+    void resolveOverflow(Node &node, vector<Page> &path, WriteLatches &held){
+        Page currentPage = path.back();
+        while(true){
+            if(node.entries.size() <= Node::MAX_ENTRIES){
+                bufferNodes.writePage(currentPage, node.serialize());
+                break;
             }
+            Page parentPage = parentOf(path);
+            if(compensation(node, currentPage, parentPage, true, held)){
+                break;
+            }
+            Node parent = split(node, currentPage, parentPage);
+            path.pop_back();
+            if(path.empty()){
+                path.push_back(parentPage);
+            }
+            currentPage = parentPage;
+            node = parent;
+        }
+    }
+
+    // Splits an overflowing node into as few nodes as hold its entries, one more than MAX_ENTRIES gives two halves
+    // around the median. The entries between the parts move up into the parent, a new root when parentPage is NULL_PAGE.
+    Node split(Node &node, Page page, Page &parentPage){
+        int count = (int)node.entries.size();
+        int parts = (count + Node::MAX_ENTRIES + 1) / (Node::MAX_ENTRIES + 1);
+        int perPart = (count - (parts - 1)) / parts;
+        int remainder = (count - (parts - 1)) % parts;
+        // First entry of every part, the separator before part i sits just ahead of starts[i]
+        vector<int> starts = {0};
+        for(int i = 0; i + 1 < parts; i++){
+            starts.push_back(starts.back() + perPart + (i < remainder ? 1 : 0) + 1);
         }
+        starts.push_back(count + 1);
+
         Node parent;
-        if(node.parent == NULL_PAGE){
+        if(parentPage == NULL_PAGE){
             root = bufferNodes.writePage(parent.serialize());
-            node.parent = root;
+            parentPage = root;
             parent.children.push_back(page);
         }
         else{
-            parent = Node::deserialize(bufferNodes.readPage(node.parent));
+            parent = Node::deserialize(bufferNodes.readPage(parentPage));
         }
 
-        sibling.parent = node.parent;
-        Page newPage = bufferNodes.writePage(sibling.serialize());
-
-        if(!node.leaf){
-            for(int i = 0; i < sibling.children.size(); i++){
-                updateChildParent(sibling.children[i], newPage);
+        for(int i = 1; i < parts; i++){
+            Node sibling;
+            sibling.leaf = node.leaf;
+            sibling.entries.assign(node.entries.begin() + starts[i], node.entries.begin() + starts[i + 1] - 1);
+            if(!node.leaf){
+                sibling.children.assign(node.children.begin() + starts[i], node.children.begin() + starts[i + 1]);
             }
+            Page newPage = bufferNodes.writePage(sibling.serialize());
+            parent.addKey(node.entries[starts[i] - 1], newPage);
         }
 
-        parent.addKey(node.entries[median], newPage);
-
-        for(int i = 0; i < median + 1; i++){
-            node.pop_back();
+        node.entries.resize(starts[1] - 1);
+        if(!node.leaf){
+            node.children.resize(starts[1]);
         }
         bufferNodes.writePage(page, node.serialize());
 
         return parent;
     }
 
-    Node merge(Node &node, Page page){
-        Node parent = Node::deserialize(bufferNodes.readPage(node.parent));
+    Node merge(Node &node, Page page, Page parentPage, WriteLatches &held){
+        Node parent = Node::deserialize(bufferNodes.readPage(parentPage));
         int index = parent.searchChild(page);
         int parentEntry;
         Page siblingPage;
         Node sibling;
         if(index > 0){
             siblingPage = parent.children[index - 1];
+            held.lock(siblingPage);
             sibling = Node::deserialize(bufferNodes.readPage(siblingPage));
             parentEntry = index - 1;
         }
         else{
             siblingPage = parent.children[index + 1];
+            held.lock(siblingPage);
             sibling = Node::deserialize(bufferNodes.readPage(siblingPage));
             swap(node, sibling);
             swap(page, siblingPage);
@@ -203,12 +442,12 @@ class BTree{
         if(!node.leaf){
             for(int i = 0; i < (int)node.children.size(); i++){
                 sibling.children.push_back(node.children[i]);
-                updateChildParent(node.children[i], siblingPage);
             }
         }
         parent.removeKey(parent.entries[parentEntry].key);
 
         bufferNodes.removePage(page);
+        held.unlockFreed(page);
         bufferNodes.writePage(siblingPage, sibling.serialize());
 
         return move(parent);
@@ -234,6 +473,7 @@ class BTree{
         file << "   </TABLE>>];\n";
 
         if(!node.leaf){
+            bufferNodes.prefetch(node.children);
             int currentId = id;
             for(int i = 0; i < (int)node.children.size(); i++){
                 file << "   \"node" << currentId << "\":f" << i <<" -> \"node" << ++id << "\"\n";
@@ -264,17 +504,17 @@ class BTree{
         file << "digraph g {\n";
         file << "node [shape = none,height=.1];\n"; 
         Page pages = diskMain.getSize();
-        if(pages > 0){
+        if(pages > SUPERBLOCK_PAGE + 1){
             file << "   DB_VIEW [label=<<TABLE BORDER=\"1\" CELLBORDER=\"1\" CELLSPACING=\"0\">\n";
             
             size_t recordSize = T::size;
 
-            for(int i = 0; i < pages; i++){
+            for(int i = SUPERBLOCK_PAGE + 1; i < pages; i++){
                 file << "       <TR><TD COLSPAN=\"4\">PAGE: " << i << "</TD></TR>\n";
                 file << "           <TR><TD>OFFSET</TD>";
                 T::getHeader(file);
                 file << "</TR>\n";
-                for(int j = 0; j < diskMain.getPageSize(); j += recordSize){
+                for(int j = 0; j < diskMain.getSlotsPerPage() * (int)recordSize; j += recordSize){
                     file << "           <TR><TD>" << j << "</TD>";
                     if(!diskMain.isEmpty({i, j})){
                         T record = T::deserialize(bufferRecords.peekRecord({i, j}));
@@ -291,33 +531,28 @@ class BTree{
         file << "}";
     }
 
-    Page findSuccessor(Page page){
-        Node node = Node::deserialize(bufferNodes.readPage(page));
-        if(node.leaf){
-            return page;
-        }
-        return findSuccessor(node.children[0]);
-    }
-
-    void printAll(Page page){
-        Node node = Node::deserialize(bufferNodes.readPage(page));
-
-        for(int i = 0; i < (int)node.entries.size() + 1; i++){
-            if(!node.leaf){
-                printAll(node.children[i]);
+    // Crabs down to the leftmost leaf below page, keep is the node waiting for the successor and stays latched
+    Page findSuccessor(Page page, vector<Page> &path, WriteLatches &held, Page keep){
+        while(true){
+            held.lock(page);
+            path.push_back(page);
+            PageGuard guard = bufferNodes.pin(page);
+            View node(guard.bytes());
+            if(isSafe(node.count(), false, WRITE_REMOVE)){
+                held.releaseAncestors(keep);
             }
-            if(i < (int)node.entries.size()){
-                T::deserialize(bufferRecords.readRecord(node.entries[i].address)).print();
-                cout << "\n";
+            if(node.leaf()){
+                return page;
             }
+            page = node.child(0);
         }
-
     }
 
     pair<int, int> getRatio(Page page){
         Node node = Node::deserialize(bufferNodes.peekPage(page));
         pair<int, int> answer = {(int)node.entries.size(), 1};
         if(!node.leaf){
+            bufferNodes.prefetch(node.children);
             for(int i = 0; i < (int)node.children.size(); i++){
                 pair<int, int> ans = getRatio(node.children[i]);
                 answer.first += ans.first;
@@ -335,91 +570,292 @@ class BTree{
         } 
     }
 
-    NodeEntry saveRecord(T &record){
-        Address address = bufferRecords.writeRecord(record.serialize());
+    NodeEntry saveRecord(T &record, Page neighbour = NULL_PAGE){
+        Address address = bufferRecords.writeRecord(record.serialize(), neighbour);
         return {record.key, address};
     }
 
-public:
-    BTree() : 
-        diskNodes("../data/nodes.txt", Node::size),
-        diskMain("../data/records.txt", T::size * BLOCKING_FACTOR),
-        
-        bufferNodes(&diskNodes, NODES_CACHE_SIZE),
-        bufferRecords(&diskMain, RECORDS_CACHE_SIZE, T::size)
-    {
-        root = NULL_PAGE;
+    // Record page of the entry next to key in a leaf, the placement hint for a new record
+    static Page neighbourPage(const Node &leaf, Key key){
+        if(leaf.entries.empty()){
+            return NULL_PAGE;
+        }
+        int index = upper_bound(leaf.entries.begin(), leaf.entries.end(), NodeEntry{key, {0, 0}}) - leaf.entries.begin();
+        return leaf.entries[max(index - 1, 0)].address.page;
     }
 
-    optional<T> search(Key key){
-        if(root == NULL_PAGE){
-            return nullopt;
+    // Number of entries in the smallest, the fill-factor sized and the largest valid subtree of a given height
+    struct SubtreeSize{
+        long long min;
+        long long target;
+        long long max;
+    };
+
+    static long long saturate(long long value){
+        return min(value, (long long)1e18);
+    }
+
+    static long long ceilDiv(long long a, long long b){
+        return (a + b - 1) / b;
+    }
+
+    SubtreeSize subtreeSize(int height, int target){
+        SubtreeSize size = {Node::MIN_ENTRIES, target, Node::MAX_ENTRIES};
+        for(int h = 1; h < height; h++){
+            size.min = saturate(Node::MIN_ENTRIES + (Node::MIN_ENTRIES + 1) * size.min);
+            size.target = saturate(target + (target + 1) * size.target);
+            size.max = saturate(Node::MAX_ENTRIES + (Node::MAX_ENTRIES + 1) * size.max);
         }
-        auto result = search(key, root);
-        if(result == nullopt){
-            return nullopt;
+        return size;
+    }
+
+    // Distributes the entries of a subtree over its children, appending node sizes to levels (levels[0] are leaves)
+    void planSubtree(long long entries, int height, bool isRoot, int target, vector<vector<int>> &levels){
+        if(height == 1){
+            levels[0].push_back((int)entries);
+            return;
+        }
+        SubtreeSize child = subtreeSize(height - 1, target);
+        long long low = max<long long>(isRoot ? 2 : Node::MIN_ENTRIES + 1, ceilDiv(entries + 1, child.max + 1));
+        long long high = min<long long>(Node::MAX_ENTRIES + 1, (entries + 1) / (child.min + 1));
+        if(low > high){
+            throw std::logic_error("BTree::bulkLoad: No valid shape for subtree");
+        }
+        long long children = clamp(ceilDiv(entries + 1, child.target + 1), low, high);
+        long long perChild = (entries - (children - 1)) / children;
+        long long remainder = (entries - (children - 1)) % children;
+
+        levels[height - 1].push_back((int)children - 1);
+        for(long long i = 0; i < children; i++){
+            planSubtree(perChild + (i < remainder ? 1 : 0), height - 1, false, target, levels);
         }
-        return T::deserialize(bufferRecords.readRecord(*result));           
     }
 
-    STATUS modify(T &record){
+    int bulkHeight(long long entries, int target){
+        int height = 1, best = 1;
+        while(true){
+            SubtreeSize size = subtreeSize(height, target);
+            long long rootMin = height == 1 ? 1 : 2 * subtreeSize(height - 1, target).min + 1;
+            if(entries < rootMin){
+                return best;
+            }
+            if(entries <= size.max){
+                best = height;
+                if(size.target >= entries){
+                    return best;
+                }
+            }
+            height++;
+        }
+    }
+
+    // Appends the writes of the calling thread's operation to the log as one group, with the root when the operation
+    // may have changed it. Called while the operation still holds its latches, so conflicting commits keep their order.
+    uint64_t logCommit(optional<Page> newRoot){
+        if(wal == nullptr){
+            return 0;
+        }
+        uint64_t lsn = wal->commit(newRoot);
+        bufferNodes.commit(lsn);
+        bufferRecords.commit(lsn);
+        return lsn;
+    }
+
+    uint64_t logCommit(const WriteLatches &held){
+        return logCommit(held.holdsRoot() ? optional<Page>(root) : nullopt);
+    }
+
+    // Waits for the commit to be as durable as configured, called once the latches are released
+    void settle(uint64_t lsn){
+        if(wal == nullptr){
+            return;
+        }
+        wal->waitFor(lsn);
+        if(wal->getSize() > WAL_CHECKPOINT_SIZE){
+            checkpoint();
+        }
+    }
+
+    void collectUsed(Page page, vector<Address> &nodes, vector<Address> &records){
+        Node node = Node::deserialize(bufferNodes.readPage(page));
+        nodes.push_back({page, 0});
+        for(const NodeEntry &entry : node.entries){
+            records.push_back(entry.address);
+        }
+        if(!node.leaf){
+            bufferNodes.prefetch(node.children);
+            for(Page child : node.children){
+                collectUsed(child, nodes, records);
+            }
+        }
+    }
+
+    // A log that was not emptied by a checkpoint means the last run crashed
+    static bool needsRecovery(bool reopen, const string &logFile){
+        return reopen && !logFile.empty() && !WriteAheadLog::isEmpty(logFile);
+    }
+
+    // Replays the operations committed since the last checkpoint into the files. Allocations are not logged,
+    // so the free space of both files is rebuilt from what the recovered tree still references.
+    void recover(){
+        optional<Page> loggedRoot = wal->replay([this](uint8_t target, Page page, size_t offset, const Data &bytes){
+            (target == LOG_NODES ? diskNodes : diskMain).redo(page, offset, bytes);
+        });
+        if(loggedRoot != nullopt){
+            root = *loggedRoot;
+        }
+        vector<Address> nodes;
+        vector<Address> records;
+        if(root != NULL_PAGE){
+            collectUsed(root, nodes, records);
+        }
+        diskNodes.rebuildFreeSpace(nodes);
+        diskMain.rebuildFreeSpace(records);
+        checkpoint();
+    }
+
+    // The node holding the key stays latched while its record is rewritten, so a concurrent remove cannot free it
+    STATUS modify(T &record, uint64_t &lsn){
+        WriteLatches held(rootLatch, latches);
+        held.lockRoot();
         if(root == NULL_PAGE){
+            held.release(false);
             return DOESNT_EXIST;
         }
-        auto result = search(record.key, root);
-        if(result == nullopt){
+        vector<Page> path;
+        STATUS status = searchPlace(record.key, WRITE_MODIFY, path, held);
+        if(status == DOESNT_EXIST){
+            held.release(false);
             return DOESNT_EXIST;
         }
 
-        bufferRecords.writeRecord(*result, record.serialize());
+        PageGuard guard = bufferNodes.pin(path.back());
+        View node(guard.bytes());
+        Address address = node.address(node.searchPlace(record.key) - 1);
+        guard.release();
 
+        bufferRecords.writeRecord(address, record.serialize());
+        lsn = logCommit(held);
+        held.release(false);
         return OK;
     }
 
-    STATUS insert(T &record){
+    // Writers crab down from the root, the latches above the lowest node that cannot split are released on the way
+    STATUS insert(T &record, uint64_t &lsn){
+        WriteLatches held(rootLatch, latches);
+        held.lockRoot();
         if(root == NULL_PAGE){
             NodeEntry entry = saveRecord(record);
             Node node = Node();
             node.leaf = true;
             node.entries.push_back(entry);
             root = bufferNodes.writePage(node.serialize());
+            lsn = logCommit(held);
             return OK;
         }
 
-        auto [status, currentPage] = searchPlace(record.key, root);
+        vector<Page> path;
+        STATUS status = searchPlace(record.key, WRITE_INSERT, path, held);
 
         if(status == ALREADY_EXISTS){
+            held.release(false);
             return status;
         }
+        Page currentPage = path.back();
 
-        NodeEntry entry = saveRecord(record);
         Node node = Node::deserialize(bufferNodes.readPage(currentPage));
+        NodeEntry entry = saveRecord(record, neighbourPage(node, record.key));
         node.addKey(entry);
 
+        resolveOverflow(node, path, held);
+        lsn = logCommit(held);
+        return OK;
+    }
+
+    // Inserts records[next] and the records after it that belong in the same leaf, moving next past them.
+    // The leaf is found with one descent that keeps its whole path latched, an overflow is resolved once all
+    // of its records are in. Returns how many records were new.
+    int insertBatch(vector<T> &records, size_t &next, uint64_t &lsn){
+        WriteLatches held(rootLatch, latches);
+        held.lockRoot();
+        if(root == NULL_PAGE){
+            Node node;
+            node.leaf = true;
+            node.entries.push_back(saveRecord(records[next++]));
+            root = bufferNodes.writePage(node.serialize());
+            lsn = logCommit(held);
+            return 1;
+        }
+
+        Key key = records[next].key;
+        // Smallest inner key above key on the path, every key below it belongs in the same leaf
+        optional<Key> upper;
+        vector<Page> path;
+        Page page = root;
         while(true){
-            if(node.entries.size() <= 2 * D){
-                bufferNodes.writePage(currentPage, node.serialize());
+            held.lock(page);
+            path.push_back(page);
+            PageGuard guard = bufferNodes.pin(page);
+            View node(guard.bytes());
+            int index = node.searchPlace(key);
+            if(node.leaf()){
                 break;
             }
-            if(compensation(node, currentPage, true)){
-                break;
+            if(index > 0 && node.key(index - 1) == key){
+                held.release(false);
+                while(next < records.size() && records[next].key == key){
+                    next++;
+                }
+                return 0;
             }
-            Node parent = split(node, currentPage);
-            currentPage = node.parent;
-            node = parent;
+            if(index < node.count()){
+                upper = node.key(index);
+            }
+            page = node.child(index);
         }
-        return OK;
-    }   
 
-    STATUS remove(Key key){
+        Node leaf = Node::deserialize(bufferNodes.readPage(path.back()));
+        vector<NodeEntry> added;
+        for(; next < records.size() && (upper == nullopt || records[next].key < *upper); next++){
+            T &record = records[next];
+            if(!added.empty() && added.back().key == record.key){
+                continue;
+            }
+            int index = leaf.searchPlace({record.key, {0, 0}});
+            if(index > 0 && leaf.entries[index - 1].key == record.key){
+                continue;
+            }
+            added.push_back(saveRecord(record, neighbourPage(leaf, record.key)));
+        }
+        if(added.empty()){
+            held.release(false);
+            return 0;
+        }
+
+        vector<NodeEntry> entries;
+        std::merge(leaf.entries.begin(), leaf.entries.end(), added.begin(), added.end(), back_inserter(entries));
+        leaf.entries = move(entries);
+        resolveOverflow(leaf, path, held);
+        lsn = logCommit(held);
+        return (int)added.size();
+    }
+
+    // Like insert, the latches above the lowest node that cannot underflow are released on the way down
+    STATUS remove(Key key, uint64_t &lsn){
+        WriteLatches held(rootLatch, latches);
+        held.lockRoot();
         if(root == NULL_PAGE){
+            held.release(false);
             return DOESNT_EXIST;
         }
-        auto [status, currentPage] = searchPlace(key, root);
+        vector<Page> path;
+        STATUS status = searchPlace(key, WRITE_REMOVE, path, held);
 
         if(status == DOESNT_EXIST){
+            held.release(false);
             return status;
         }
+        Page currentPage = path.back();
 
         Node node = Node::deserialize(bufferNodes.readPage(currentPage));
         int index = node.searchPlace({key, {0, 0}});
@@ -429,29 +865,31 @@ public:
             node.removeKey(key);
         }
         else{
-            Page successorPage = findSuccessor(node.children[index]);
+            Page successorPage = findSuccessor(node.children[index], path, held, currentPage);
             Node successor = Node::deserialize(bufferNodes.readPage(successorPage));
-            node.entries[index - 1] = successor.entries[0];
+            // Only the removed entry changes, it is overwritten on the cached page
+            bufferNodes.editPage(currentPage, [&](Data &data){
+                MutableNodeView<D>(data).setEntry(index - 1, successor.entries[0]);
+            });
             successor.pop_front();
 
-            bufferNodes.writePage(currentPage, node.serialize());
             currentPage = successorPage;
             node = move(successor);
         }
 
 
         while(true){
-            if((int)node.entries.size() >= D){
+            if((int)node.entries.size() >= Node::MIN_ENTRIES){
                 bufferNodes.writePage(currentPage, node.serialize());
                 break;
             }
             if(currentPage == root){
                 if((int)node.entries.size() < 1){
                     bufferNodes.removePage(currentPage);
+                    held.unlockFreed(currentPage);
                     if(!node.leaf){
                         root = node.children[0];
                         node = Node::deserialize(bufferNodes.readPage(root));
-                        node.parent = NULL_PAGE;
                         currentPage = root;
                     }
                     else{
@@ -462,23 +900,384 @@ public:
                 bufferNodes.writePage(currentPage, node.serialize());
                 break;
             }
-            if(compensation(node, currentPage, false)){
+            Page parentPage = parentOf(path);
+            if(compensation(node, currentPage, parentPage, false, held)){
                 break;
             }
-            Node parent = merge(node, currentPage);
-            if((int)parent.entries.size() >= D){
-                bufferNodes.writePage(node.parent, parent.serialize());
+            Node parent = merge(node, currentPage, parentPage, held);
+            if((int)parent.entries.size() >= Node::MIN_ENTRIES){
+                bufferNodes.writePage(parentPage, parent.serialize());
                 break;
             }
-            currentPage = node.parent;
+            path.pop_back();
+            currentPage = parentPage;
             node = move(parent);
         }
+        lsn = logCommit(held);
         return OK;
     }
 
-    void printAll(){
+public:
+    static const int ORDER = D;
+
+    // Forward cursor over the records with keys in [lo, hi], records are fetched in batches grouped by page.
+    // Cursors take no latches, the tree must not be modified while a cursor is in use.
+    class Cursor{
+        struct Frame{
+            Node node;
+            int index;
+        };
+
+        BTree* tree;
+        Key hi;
+        vector<Frame> stack;
+        vector<T> batch;
+        int position = 0;
+
+        // Children the scan will visit are hinted to the cache as soon as their parent is read
+        void descend(Page page, Key lo){
+            while(true){
+                Node node = Node::deserialize(tree->bufferNodes.readPage(page));
+                int index = lower_bound(node.entries.begin(), node.entries.end(), NodeEntry{lo, {0, 0}}) - node.entries.begin();
+                if(!node.leaf){
+                    int last = index;
+                    while(last < (int)node.entries.size() && node.entries[last].key <= hi){
+                        last++;
+                    }
+                    tree->bufferNodes.prefetch(vector<Page>(node.children.begin() + index, node.children.begin() + last + 1));
+                }
+                stack.push_back({move(node), index});
+                if(stack.back().node.leaf){
+                    return;
+                }
+                page = stack.back().node.children[index];
+            }
+        }
+
+        optional<NodeEntry> nextEntry(){
+            while(!stack.empty()){
+                Frame &frame = stack.back();
+                if(frame.index == (int)frame.node.entries.size()){
+                    stack.pop_back();
+                    continue;
+                }
+                NodeEntry entry = frame.node.entries[frame.index++];
+                if(entry.key > hi){
+                    stack.clear();
+                    return nullopt;
+                }
+                if(!frame.node.leaf){
+                    descend(frame.node.children[frame.index], numeric_limits<Key>::min());
+                }
+                return entry;
+            }
+            return nullopt;
+        }
+
+        void fillBatch(){
+            vector<Address> addresses;
+            while((int)addresses.size() < SCAN_BATCH_SIZE){
+                optional<NodeEntry> entry = nextEntry();
+                if(entry == nullopt){
+                    break;
+                }
+                addresses.push_back(entry->address);
+            }
+            batch.clear();
+            position = 0;
+            for(const Data &data : tree->bufferRecords.readRecords(addresses)){
+                batch.push_back(T::deserialize(data));
+            }
+        }
+
+    public:
+        Cursor(BTree *tree, Key lo, Key hi) : tree(tree), hi(hi){
+            if(tree->root != NULL_PAGE && lo <= hi){
+                descend(tree->root, lo);
+            }
+        }
+
+        optional<T> next(){
+            if(position == (int)batch.size()){
+                fillBatch();
+                if(batch.empty()){
+                    return nullopt;
+                }
+            }
+            return batch[position++];
+        }
+    };
+
+    // With reopen the tree is attached to files written by an earlier instance instead of starting empty.
+    // With a log file every change is logged before it reaches the files, and reopening replays what a crash lost.
+    // io picks how both files are read and written.
+    BTree(const string &nodesFile = "../data/nodes.txt", const string &recordsFile = "../data/records.txt", bool reopen = false, const string &logFile = "",
+        IO_BACKEND io = DEFAULT_IO_BACKEND) :
+        diskNodes(nodesFile, Node::size, reopen, !needsRecovery(reopen, logFile), io),
+        diskMain(recordsFile, T::size * BLOCKING_FACTOR, T::size, reopen, !needsRecovery(reopen, logFile), io),
+        
+        bufferNodes(&diskNodes, NODES_CACHE_SIZE),
+        bufferRecords(&diskMain, RECORDS_CACHE_SIZE, T::size)
+    {
+        root = NULL_PAGE;
+        if(reopen){
+            if(diskNodes.superblock().order != D){
+                throw std::runtime_error("BTree: " + nodesFile + " was written with a different order");
+            }
+            root = diskNodes.superblock().root;
+        }
+        if(!logFile.empty()){
+            wal = make_unique<WriteAheadLog>(logFile, !reopen);
+            bufferNodes.setLog(wal.get(), LOG_NODES);
+            bufferRecords.setLog(wal.get(), LOG_RECORDS);
+            if(needsRecovery(reopen, logFile)){
+                recover();
+            }
+            else if(!reopen){
+                checkpoint();
+            }
+        }
+    }
+
+    static unique_ptr<BTree> open(const string &directory, bool logged = false, IO_BACKEND io = DEFAULT_IO_BACKEND){
+        return make_unique<BTree>(directory + "/nodes.txt", directory + "/records.txt", true, logged ? directory + "/log.txt" : "", io);
+    }
+
+    // The cleaners stop first, the log they sync is destroyed before the caches
+    ~BTree(){
+        setCleaner(0);
+        close();
+    }
+
+    // Flushes cached pages and stores the root in the superblock, also done on destruction
+    void close(){
+        checkpoint();
+    }
+
+    // Like close, then empties the log since the files hold everything it describes. Waits for running writers,
+    // a logged tree checkpoints on its own once the log outgrows WAL_CHECKPOINT_SIZE.
+    void checkpoint(){
+        unique_lock<shared_mutex> quiet(checkpointLock);
+        bufferNodes.flush();
+        bufferRecords.flush();
+        diskNodes.storeRoot(root, D);
+        diskNodes.sync();
+        diskMain.sync();
+        if(wal != nullptr){
+            wal->truncate();
+        }
+    }
+
+    // GROUP_COMMIT by default, with ASYNC_COMMIT syncLog makes everything committed so far durable
+    void setDurability(DURABILITY durability){
+        if(wal != nullptr){
+            wal->setDurability(durability);
+        }
+    }
+
+    void syncLog(){
+        if(wal != nullptr){
+            wal->flush();
+        }
+    }
+
+    LogStats getLogStats(){
+        return wal != nullptr ? wal->stats : LogStats();
+    }
+
+    // Safe to call from any number of threads together with modify, insert and remove
+    optional<T> search(Key key){
+        optional<T> result;
+        while(!trySearch(key, result)){
+
+        }
+        return result;
+    }
+
+    // Looks up every key of a batch with one walk of the tree in key order, probes below the same node go down
+    // together and the records found are read grouped by page. Results are in the order of keys, safe to call
+    // from any number of threads like search.
+    vector<optional<T>> searchMany(const vector<Key> &keys){
+        vector<optional<T>> results;
+        while(!trySearchMany(keys, results)){
+
+        }
+        return results;
+    }
+
+    // Builds the tree bottom-up from records sorted by strictly increasing key, the tree has to be empty.
+    // Every node gets about fillFactor * 2D entries, so later inserts have room before splitting.
+    // A logged tree commits node by node and logs the root last, a crash midway recovers an empty tree.
+    template <typename Iterator>
+    void bulkLoad(Iterator first, Iterator last, double fillFactor = 1.0){
         if(root != NULL_PAGE){
-            printAll(root);
+            throw std::logic_error("BTree::bulkLoad: Tree is not empty");
+        }
+        if(fillFactor <= 0 || fillFactor > 1){
+            throw std::invalid_argument("BTree::bulkLoad: Fill factor must be in (0, 1]");
+        }
+        long long entries = 0;
+        Key previous = 0;
+        for(Iterator it = first; it != last; it++){
+            if(entries > 0 && !(previous < it->key)){
+                throw std::invalid_argument("BTree::bulkLoad: Records are not sorted by unique keys");
+            }
+            previous = it->key;
+            entries++;
+        }
+        if(entries == 0){
+            return;
+        }
+
+        int target = clamp((int)(fillFactor * Node::MAX_ENTRIES + 0.5), Node::MIN_ENTRIES, Node::MAX_ENTRIES);
+        int height = bulkHeight(entries, target);
+        vector<vector<int>> levels(height);
+        planSubtree(entries, height, true, target, levels);
+
+        vector<Page> pages;
+        vector<NodeEntry> separators;
+        Iterator it = first;
+        for(int i = 0; i < (int)levels[0].size(); i++){
+            Node leaf;
+            leaf.leaf = true;
+            for(int j = 0; j < levels[0][i]; j++){
+                T record = *it++;
+                leaf.entries.push_back(saveRecord(record));
+            }
+            pages.push_back(bufferNodes.writePage(leaf.serialize()));
+            if(i + 1 < (int)levels[0].size()){
+                T record = *it++;
+                separators.push_back(saveRecord(record));
+            }
+            settle(logCommit(nullopt));
+        }
+
+        for(int level = 1; level < height; level++){
+            vector<Page> upperPages;
+            vector<NodeEntry> upperSeparators;
+            int child = 0;
+            for(int i = 0; i < (int)levels[level].size(); i++){
+                Node node;
+                node.children.push_back(pages[child]);
+                for(int j = 0; j < levels[level][i]; j++){
+                    node.entries.push_back(separators[child]);
+                    node.children.push_back(pages[++child]);
+                }
+                upperPages.push_back(bufferNodes.writePage(node.serialize()));
+                if(i + 1 < (int)levels[level].size()){
+                    upperSeparators.push_back(separators[child++]);
+                }
+                settle(logCommit(nullopt));
+            }
+            pages = move(upperPages);
+            separators = move(upperSeparators);
+        }
+        root = pages[0];
+        settle(logCommit(optional<Page>(root)));
+    }
+
+    // Where new records are stored in the record file, FIRST_FIT by default
+    void setPlacement(PLACEMENT placement){
+        bufferRecords.setPlacement(placement);
+    }
+
+    // Applies to the node and the record caches separately, LRU_POLICY by default
+    void setReplacement(REPLACEMENT nodes, REPLACEMENT records){
+        bufferNodes.setReplacement(nodes);
+        bufferRecords.setReplacement(records);
+    }
+
+    // Dirty pages evicted together from each cache, see BufferManager::setEvictionBatch
+    void setEvictionBatch(int pages){
+        bufferNodes.setEvictionBatch(pages);
+        bufferRecords.setEvictionBatch(pages);
+    }
+
+    // Keeps the frames coldest pages of each cache clean from a background thread, 0 stops it
+    void setCleaner(int frames){
+        bufferNodes.setCleaner(frames);
+        bufferRecords.setCleaner(frames);
+    }
+
+    // Pages written back by evictions and by the cleaners of both caches
+    WriteBackStats getWriteBackStats(){
+        WriteBackStats nodes = bufferNodes.getWriteBackStats();
+        WriteBackStats records = bufferRecords.getWriteBackStats();
+        return {nodes.foreground + records.foreground, nodes.background + records.background};
+    }
+
+    IOStats getNodeStats(){
+        return diskNodes.stats;
+    }
+
+    IOStats getRecordStats(){
+        return diskMain.stats;
+    }
+
+    // With a log every modify, insert and remove is committed as one group, durable as set by setDurability
+    STATUS modify(T &record){
+        uint64_t lsn = 0;
+        STATUS status;
+        {
+            shared_lock<shared_mutex> running(checkpointLock);
+            status = modify(record, lsn);
+        }
+        settle(lsn);
+        return status;
+    }
+
+    STATUS insert(T &record){
+        uint64_t lsn = 0;
+        STATUS status;
+        {
+            shared_lock<shared_mutex> running(checkpointLock);
+            status = insert(record, lsn);
+        }
+        settle(lsn);
+        return status;
+    }
+
+    // Inserts a batch of records, which is left sorted by key. Records bound for the same leaf share one descent
+    // and the leaf's overflow is resolved once for all of them, by compensation or by a split into as many nodes
+    // as needed. Each leaf is committed as one group. Keys already in the tree or repeated in the batch are
+    // skipped, returns how many records were inserted.
+    int insertBatch(vector<T> &records){
+        stable_sort(records.begin(), records.end(), [](const T &a, const T &b){
+            return a.key < b.key;
+        });
+        int inserted = 0;
+        size_t next = 0;
+        while(next < records.size()){
+            uint64_t lsn = 0;
+            {
+                shared_lock<shared_mutex> running(checkpointLock);
+                inserted += insertBatch(records, next, lsn);
+            }
+            settle(lsn);
+        }
+        return inserted;
+    }
+
+    STATUS remove(Key key){
+        uint64_t lsn = 0;
+        STATUS status;
+        {
+            shared_lock<shared_mutex> running(checkpointLock);
+            status = remove(key, lsn);
+        }
+        settle(lsn);
+        return status;
+    }
+
+    Cursor scan(Key lo, Key hi){
+        return Cursor(this, lo, hi);
+    }
+
+    void printAll(){
+        Cursor cursor = scan(numeric_limits<Key>::min(), numeric_limits<Key>::max());
+        while(optional<T> record = cursor.next()){
+            record->print();
+            cout << "\n";
         }
     }
 
@@ -502,7 +1301,7 @@ public:
             return 0;
         }
         auto [keys, nodes] = getRatio(root);
-        return (double)keys / (nodes * 2 * D);
+        return (double)keys / (nodes * Node::MAX_ENTRIES);
     }
 
     int getHeight(){
@@ -513,4 +1312,6 @@ public:
         getHeight(root, height);
         return height;
     }
-};
\ No newline at end of file
+};
+template <typename T, size_t PageBytes>
+using PagedBTree = BTree<T, orderForPage(PageBytes)>;
@@ -1,83 +1,562 @@
 #pragma once
-#include <list>
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <shared_mutex>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
 #include "disk_manager.h"
+#include "replacement_policy.h"
+#include "wal.h"
 using namespace std;
 
-using LRUlist = list<Page>;
-
-struct Item{
+// Cached page. The latch protects data, pins keep the frame from being evicted.
+// With a log, lsn is the last commit that changed the page and uncommitted counts changes of operations still running.
+// With a mapped file a clean page is read in place through mapped, data is filled only once a copy is needed.
+struct Frame{
     Data data;
-    bool dirty = false;
-    LRUlist::iterator it;
+    const Byte* mapped = nullptr;
+    size_t mappedSize = 0;
+    once_flag copied;
+    atomic<bool> dirty{false};
+    atomic<int> pins{0};
+    atomic<uint64_t> lsn{0};
+    atomic<int> uncommitted{0};
+    bool loaded = false;
+    shared_mutex latch;
 };
 
-using CacheMap = unordered_map<Page, Item>;
+// Pins a cached page and holds its latch for as long as the guard lives, so it can be accessed without copying.
+// Readers share the latch, a guard pinned for writing holds it exclusively.
+class PageGuard{
+    friend class BufferManager;
+
+    shared_ptr<Frame> frame;
+    Page page = NULL_PAGE;
+    bool exclusive = false;
+
+public:
+    PageGuard(){
 
+    }
+
+    // Takes over a pin already counted in frame->pins and waits for the latch
+    PageGuard(shared_ptr<Frame> frame, Page page, bool exclusive) : PageGuard(move(frame), page, exclusive, adopt_lock){
+        if(exclusive){
+            this->frame->latch.lock();
+        }
+        else{
+            this->frame->latch.lock_shared();
+        }
+    }
+
+    // Takes over a pin and a latch the caller already holds
+    PageGuard(shared_ptr<Frame> frame, Page page, bool exclusive, adopt_lock_t) : frame(move(frame)), page(page), exclusive(exclusive){
+
+    }
+
+    PageGuard(const PageGuard&) = delete;
+    PageGuard& operator=(const PageGuard&) = delete;
+
+    PageGuard(PageGuard &&other) : frame(move(other.frame)), page(other.page), exclusive(other.exclusive){
+
+    }
+
+    PageGuard& operator=(PageGuard &&other){
+        if(this != &other){
+            release();
+            frame = move(other.frame);
+            page = other.page;
+            exclusive = other.exclusive;
+        }
+        return *this;
+    }
+
+    // Copies a mapped page the first time, readers sharing the latch race to the copy and only one makes it
+    const Data& read() const{
+        if(frame->mapped != nullptr){
+            call_once(frame->copied, [this](){
+                frame->data.assign(frame->mapped, frame->mapped + frame->mappedSize);
+            });
+        }
+        return frame->data;
+    }
+
+    // The page without copying, in the file mapping when it is mapped
+    const Byte* bytes() const{
+        return frame->mapped != nullptr ? frame->mapped : frame->data.data();
+    }
 
+    // A mapped page is copied before its first change, the mapping only changes when the page is written back
+    Data& write(){
+        if(!exclusive){
+            throw std::logic_error("PageGuard::write: Page is pinned for reading");
+        }
+        if(frame->mapped != nullptr){
+            frame->data.assign(frame->mapped, frame->mapped + frame->mappedSize);
+            frame->mapped = nullptr;
+        }
+        frame->dirty = true;
+        return frame->data;
+    }
+
+    Page getPage() const{
+        return page;
+    }
+
+    bool isLoaded() const{
+        return frame->loaded;
+    }
+
+    void release(){
+        if(frame != nullptr){
+            if(exclusive){
+                frame->latch.unlock();
+            }
+            else{
+                frame->latch.unlock_shared();
+            }
+            frame->pins--;
+            frame = nullptr;
+        }
+    }
+
+    ~PageGuard(){
+        release();
+    }
+};
+
+using FrameMap = unordered_map<Page, shared_ptr<Frame>>;
+using PinnedFrames = vector<pair<Page, shared_ptr<Frame>>>;
+
+// Part of the page table with its own lock and replacement policy. Pages evicted dirty stay in evicting until
+// their write back finishes, even when cached again meanwhile, so a miss on them never reads the stale disk
+// copy and a page freed and reused never gets a new frame that an old write back could overtake.
+struct Shard{
+    mutex lock;
+    FrameMap frames;
+    FrameMap evicting;
+    unique_ptr<ReplacementPolicy> policy = make_unique<LRUPolicy>();
+    int capacity;
+};
+
+
+// Page cache safe to share between threads. The page table is split into shards by page number,
+// a shard lock is held only while looking up or replacing frames, never during disk I/O.
 class BufferManager{
     DiskManager* diskManager;
-    LRUlist queue;
-    CacheMap pageCache;
+    vector<unique_ptr<Shard>> shards;
     int capacity;
     size_t recordSize;
+    PLACEMENT placement = FIRST_FIT;
+    WriteAheadLog* log = nullptr;
+    uint8_t logTarget = 0;
+    // Frames changed by the running operation of each thread, pinned until it commits
+    mutex pendingLock;
+    unordered_map<thread::id, vector<shared_ptr<Frame>>> pending;
+    // Pages and record slots the running operation of each thread freed, reusable once it commits
+    unordered_map<thread::id, vector<Page>> freedPages;
+    unordered_map<thread::id, vector<Address>> freedSlots;
+    mutex flushLock;
+    int evictionBatch = 1;
+    // Background cleaner writing back the cleanFrames coldest pages of every shard ahead of eviction
+    thread cleaner;
+    mutex cleanerLock;
+    condition_variable cleanerWake;
+    bool cleanerRunning = false;
+    bool cleanerWoken = false;
+    atomic<int> cleanFrames{0};
+    atomic<int> foregroundWrites{0};
+    atomic<int> backgroundWrites{0};
+
+    Shard& shardOf(Page page){
+        return *shards[page % shards.size()];
+    }
 
-    void removeLastElement(){
-        Page p = queue.back();
-        Item& item = pageCache[p];
-        if(item.dirty){
-            diskManager->writePage(p, item.data);
+    // Detaches an unpinned page from the shard. A dirty page is kept pinned in evicting until it is written back and
+    // its latch is taken shared at once, before anyone can find it there. Unpinned, nobody holds the latch exclusively,
+    // so it is only tried, no latch is ever waited for under a shard lock. False when the page stays cached.
+    bool detach(Shard &shard, Page page, PinnedFrames &dirtyVictims){
+        shared_ptr<Frame> &victim = shard.frames[page];
+        if(victim->dirty){
+            if(!victim->latch.try_lock_shared()){
+                shard.policy->restore(page);
+                return false;
+            }
+            victim->pins++;
+            shard.evicting[page] = victim;
+            dirtyVictims.push_back({page, victim});
         }
-        queue.pop_back();
-        pageCache.erase(p);
+        shard.frames.erase(page);
+        return true;
     }
 
-    Item& promoteAngGetItem(Page page){
-        Item& item = pageCache[page];
-        queue.splice(queue.begin(), queue, item.it);
+    // Detaches the unpinned page chosen by the replacement policy, false when every page is pinned and the shard
+    // has to grow past capacity. A dirty victim is handed back latched for write back, together with up to
+    // evictionBatch - 1 of the next coldest dirty pages so they are written in one sorted batch.
+    bool removeLastElement(Shard &shard, PinnedFrames &dirtyVictims){
+        optional<Page> p;
+        if(cleanFrames > 0){
+            // With the cleaner running a clean page among the coldest goes first, so the miss does not wait for a write
+            vector<Page> cold = shard.policy->coldest(cleanFrames);
+            p = shard.policy->victim([&shard, &cold](Page page){
+                const shared_ptr<Frame> &frame = shard.frames[page];
+                return frame->pins == 0 && !frame->dirty && find(cold.begin(), cold.end(), page) != cold.end();
+            });
+        }
+        if(p == nullopt && log != nullptr){
+            // Pages whose log records are already on disk go first, anything else needs a log sync before its write
+            uint64_t durable = log->getDurableLsn();
+            p = shard.policy->victim([&shard, durable](Page page){
+                const shared_ptr<Frame> &frame = shard.frames[page];
+                return frame->pins == 0 && (!frame->dirty || frame->lsn <= durable);
+            });
+        }
+        if(p == nullopt){
+            p = shard.policy->victim([&shard](Page page){
+                return shard.frames[page]->pins == 0;
+            });
+        }
+        if(p == nullopt){
+            return false;
+        }
+        if(!detach(shard, *p, dirtyVictims)){
+            return false;
+        }
+        while(!dirtyVictims.empty() && (int)dirtyVictims.size() < evictionBatch){
+            optional<Page> cold = shard.policy->victim([&shard](Page page){
+                const shared_ptr<Frame> &frame = shard.frames[page];
+                return frame->pins == 0 && frame->dirty;
+            });
+            if(cold == nullopt || !detach(shard, *cold, dirtyVictims)){
+                break;
+            }
+        }
+        return true;
+    }
 
-        return item;
+    // Writes the dirty pages among frames, whose latches the caller holds, as one batch and returns how many. A page changed by an
+    // operation that has not committed is never written, its log records come first. Syncing the log under the
+    // latches is safe, the thread doing the sync waits for no latch.
+    int writeBack(const PinnedFrames &frames){
+        vector<pair<Page, const Data*>> pages;
+        uint64_t lsn = 0;
+        for(auto &[page, frame] : frames){
+            if(frame->uncommitted == 0 && frame->dirty.exchange(false)){
+                pages.push_back({page, &frame->data});
+                lsn = max(lsn, frame->lsn.load());
+            }
+        }
+        if(pages.empty()){
+            return 0;
+        }
+        if(log != nullptr){
+            log->flushTo(lsn);
+        }
+        diskManager->writePages(pages);
+        return (int)pages.size();
+    }
+
+    // Stages the change for the log and keeps the frame pinned until the operation commits
+    void logWrite(PageGuard &guard, size_t offset, const Byte *data, size_t size){
+        if(log == nullptr){
+            return;
+        }
+        log->append(logTarget, guard.page, offset, data, size);
+        guard.frame->uncommitted++;
+        guard.frame->pins++;
+        lock_guard<mutex> lock(pendingLock);
+        pending[this_thread::get_id()].push_back(guard.frame);
+    }
+
+    // The victims were latched when they were detached, so eviction never waits for a latch
+    void finishEviction(Shard &shard, const PinnedFrames &victims){
+        int written = writeBack(victims);
+        foregroundWrites += written;
+        if(written > 0){
+            wakeCleaner();
+        }
+        for(auto &[page, victim] : victims){
+            victim->latch.unlock_shared();
+        }
+
+        lock_guard<mutex> lock(shard.lock);
+        for(auto &[page, victim] : victims){
+            victim->pins--;
+            shard.evicting.erase(page);
+        }
+    }
+
+    // A dirty eviction means the cleaner fell behind, it starts its next round at once
+    void wakeCleaner(){
+        {
+            lock_guard<mutex> lock(cleanerLock);
+            if(!cleanerRunning){
+                return;
+            }
+            cleanerWoken = true;
+        }
+        cleanerWake.notify_one();
+    }
+
+    // Writes back the dirty pages among the coldest of the shard and returns how many. Pages latched by someone else are skipped, so
+    // the cleaner never waits for a latch. It writes under flushLock, a flush never misses a page it is writing.
+    int clean(Shard &shard){
+        PinnedFrames frames;
+        {
+            lock_guard<mutex> lock(shard.lock);
+            for(Page page : shard.policy->coldest(cleanFrames)){
+                auto it = shard.frames.find(page);
+                if(it != shard.frames.end() && it->second->dirty && it->second->uncommitted == 0){
+                    it->second->pins++;
+                    frames.push_back(*it);
+                }
+            }
+        }
+        int written;
+        {
+            lock_guard<mutex> flushing(flushLock);
+            PinnedFrames latched;
+            for(auto &[page, frame] : frames){
+                if(frame->latch.try_lock_shared()){
+                    latched.push_back({page, frame});
+                }
+            }
+            written = writeBack(latched);
+            for(auto &[page, frame] : latched){
+                frame->latch.unlock_shared();
+            }
+        }
+        for(auto &[page, frame] : frames){
+            frame->pins--;
+        }
+        backgroundWrites += written;
+        return written;
+    }
+
+    // Runs rounds over every shard for as long as they find dirty pages, then sleeps for CLEANER_INTERVAL
+    // milliseconds or until woken
+    void cleanLoop(){
+        unique_lock<mutex> guard(cleanerLock);
+        bool idle = true;
+        while(cleanerRunning){
+            if(idle){
+                cleanerWake.wait_for(guard, chrono::milliseconds(CLEANER_INTERVAL), [this](){
+                    return cleanerWoken || !cleanerRunning;
+                });
+            }
+            cleanerWoken = false;
+            if(!cleanerRunning){
+                break;
+            }
+            guard.unlock();
+            int written = 0;
+            for(auto &shard : shards){
+                written += clean(*shard);
+            }
+            idle = written == 0;
+            guard.lock();
+        }
+    }
+
+    void stopCleaner(){
+        {
+            lock_guard<mutex> lock(cleanerLock);
+            cleanerRunning = false;
+        }
+        cleanerWake.notify_one();
+        if(cleaner.joinable()){
+            cleaner.join();
+        }
+    }
+
+    // Pins page in its shard. A missing page gets a new frame which is returned exclusively latched
+    // with created set, the caller has to fill it and mark it loaded.
+    shared_ptr<Frame> lookup(Page page, bool &created){
+        Shard &shard = shardOf(page);
+        shared_ptr<Frame> fresh;
+        while(true){
+            shared_ptr<Frame> frame;
+            PinnedFrames victims;
+            {
+                lock_guard<mutex> lock(shard.lock);
+                auto it = shard.frames.find(page);
+                if(it != shard.frames.end()){
+                    it->second->pins++;
+                    shard.policy->touch(page);
+                    frame = it->second;
+                }
+                else if(shard.evicting.count(page) > 0 || fresh != nullptr){
+                    bool room = (int)shard.frames.size() < shard.capacity;
+                    if(!room){
+                        // A clean victim is dropped at once, with every page pinned the shard grows past capacity
+                        room = !removeLastElement(shard, victims) || victims.empty();
+                    }
+                    if(room){
+                        auto evicted = shard.evicting.find(page);
+                        frame = evicted != shard.evicting.end() ? evicted->second : fresh;
+                        frame->pins++;
+                        shard.frames[page] = frame;
+                        shard.policy->admit(page);
+                    }
+                }
+            }
+            if(!victims.empty()){
+                // Room is made before the page is inserted, so no thread waits for the new frame meanwhile
+                finishEviction(shard, victims);
+                continue;
+            }
+            if(frame != nullptr){
+                created = (frame == fresh);
+                if(fresh != nullptr && !created){
+                    fresh->latch.unlock();
+                }
+                return frame;
+            }
+            // The new frame is latched before taking the shard lock again, no latch is ever waited for under a shard lock
+            fresh = make_shared<Frame>();
+            fresh->latch.lock();
+        }
+    }
+
+    // Drops a frame whose load failed, threads waiting on it see it not loaded and look the page up again
+    void discard(Page page, const shared_ptr<Frame> &frame){
+        Shard &shard = shardOf(page);
+        {
+            lock_guard<mutex> lock(shard.lock);
+            auto it = shard.frames.find(page);
+            if(it != shard.frames.end() && it->second == frame){
+                shard.frames.erase(it);
+                shard.policy->forget(page);
+            }
+        }
+        frame->latch.unlock();
+        frame->pins--;
+    }
+
+    // With load a missing page is read from disk, otherwise its frame is left for the caller to overwrite
+    PageGuard acquire(Page page, bool exclusive, bool load){
+        while(true){
+            bool created;
+            shared_ptr<Frame> frame = lookup(page, created);
+            if(!created){
+                PageGuard guard(move(frame), page, exclusive);
+                if(guard.isLoaded()){
+                    return guard;
+                }
+                continue;
+            }
+
+            if(load){
+                try{
+                    frame->mapped = diskManager->mapPage(page);
+                    if(frame->mapped != nullptr){
+                        frame->mappedSize = diskManager->getPageSize();
+                    }
+                    else{
+                        frame->data = diskManager->readPage(page);
+                    }
+                }
+                catch(...){
+                    discard(page, frame);
+                    throw;
+                }
+            }
+            frame->loaded = true;
+            if(!exclusive){
+                frame->latch.unlock();
+                frame->latch.lock_shared();
+            }
+            return PageGuard(move(frame), page, exclusive, adopt_lock);
+        }
+    }
+
+    // Loads the missing pages with one batch of reads, each frame is filled and unlatched as its read completes.
+    // Cached pages are left alone, the caller pins every page again to use it.
+    void load(const vector<Page> &pages){
+        vector<Page> missing;
+        unordered_map<Page, shared_ptr<Frame>> frames;
+        for(Page page : pages){
+            bool created;
+            shared_ptr<Frame> frame = lookup(page, created);
+            if(created){
+                missing.push_back(page);
+                frames[page] = move(frame);
+            }
+            else{
+                frame->pins--;
+            }
+        }
+        try{
+            diskManager->readPages(missing, [&frames](Page page, Data &data){
+                shared_ptr<Frame> frame = move(frames[page]);
+                frames.erase(page);
+                frame->data = move(data);
+                frame->loaded = true;
+                frame->latch.unlock();
+                frame->pins--;
+            });
+        }
+        catch(...){
+            for(auto &[page, frame] : frames){
+                discard(page, frame);
+            }
+            throw;
+        }
+    }
+
+    // Frames of every shard, each pinned so it stays cached until the caller unpins it
+    PinnedFrames pinAll(bool onlyDirty){
+        PinnedFrames frames;
+        for(auto &shard : shards){
+            lock_guard<mutex> lock(shard->lock);
+            for(auto &[page, frame] : shard->frames){
+                if(!onlyDirty || frame->dirty){
+                    frame->pins++;
+                    frames.push_back({page, frame});
+                }
+            }
+        }
+        return frames;
     }
 
 public:
-    
+
     BufferManager(){
 
     }
 
-    BufferManager(DiskManager *diskManager, int capacity){
-        this->diskManager = diskManager;
-        this->capacity = capacity;
+    BufferManager(DiskManager *diskManager, int capacity) : BufferManager(diskManager, capacity, 0){
+
     }
 
+    // Small caches keep one shard so replacement stays global, larger ones get a shard per SHARD_MIN_FRAMES frames
     BufferManager(DiskManager *diskManager, int capacity, size_t recordSize){
         this->diskManager = diskManager;
         this->capacity = capacity;
         this->recordSize = recordSize;
-    }
 
-    void writePage(Page page, const Data &data){
-        if(pageCache.find(page) != pageCache.end()){
-            Item& item = promoteAngGetItem(page);
-            item.data = data;
-            item.dirty = true;
+        int count = max(1, min(BUFFER_SHARDS, capacity / SHARD_MIN_FRAMES));
+        for(int i = 0; i < count; i++){
+            shards.push_back(make_unique<Shard>());
+            shards.back()->capacity = max(1, capacity / count + (i < capacity % count ? 1 : 0));
         }
-        else{
-            if((int)queue.size() >= capacity){
-                removeLastElement();
-            }
-            Item newItem;
-            newItem.data = data;
-            newItem.dirty = true;
+    }
 
-            queue.push_front(page);
-            newItem.it = queue.begin();
-            pageCache[page] = move(newItem); 
-        }
+    // data may be shorter than the page when the disk pads pages to whole sectors or device blocks
+    void writePage(Page page, const Data &data){
+        PageGuard guard = acquire(page, true, false);
+        Data &bytes = guard.write();
+        bytes = data;
+        bytes.resize(diskManager->getPageSize(), 0);
+        logWrite(guard, 0, data.data(), data.size());
     }
-    
+
     Page writePage(const Data &data){
         Page page = diskManager->allocatePage();
         writePage(page, data);
@@ -85,72 +564,199 @@ public:
     }
 
     Data readPage(Page page){
-        if(pageCache.find(page) != pageCache.end()){
-            Item& item = promoteAngGetItem(page);
-            return item.data;
+        PageGuard guard = pin(page);
+        return Data(guard.bytes(), guard.bytes() + diskManager->getPageSize());
+    }
+
+    // Writes every dirty cached page back to disk in one batch sorted by page, runs of adjacent pages merged into
+    // single writes. The pages stay cached. One flush runs at a time, it is the only code holding several frame
+    // latches, all of them shared, while waiting for the next.
+    void flush(){
+        lock_guard<mutex> flushing(flushLock);
+        PinnedFrames frames = pinAll(true);
+        vector<shared_lock<shared_mutex>> latches;
+        for(auto &[page, frame] : frames){
+            latches.emplace_back(frame->latch);
         }
-        else{
-            if((int)queue.size() >= capacity){
-                removeLastElement();
+        writeBack(frames);
+        latches.clear();
+        for(auto &[page, frame] : frames){
+            frame->pins--;
+        }
+    }
+
+    // Starts a thread writing back dirty pages among the frames coldest pages of every shard, so evictions
+    // mostly find their victim clean. 0 stops it, the default.
+    void setCleaner(int frames){
+        if(frames < 0){
+            throw std::invalid_argument("BufferManager::setCleaner: Negative number of frames");
+        }
+        stopCleaner();
+        cleanFrames = frames;
+        if(frames > 0){
+            cleanerRunning = true;
+            cleaner = thread([this](){
+                cleanLoop();
+            });
+        }
+    }
+
+    WriteBackStats getWriteBackStats(){
+        return {foregroundWrites, backgroundWrites};
+    }
+
+    // Evicting a dirty page takes up to pages of the coldest dirty pages of its shard with it, written in one
+    // sorted batch. 1 by default, only the victim.
+    void setEvictionBatch(int pages){
+        if(pages < 1){
+            throw std::invalid_argument("BufferManager::setEvictionBatch: Batch must hold at least one page");
+        }
+        evictionBatch = pages;
+    }
+
+    PageGuard pin(Page page){
+        return acquire(page, false, true);
+    }
+
+    // Hint that pages will be read soon. Those not cached are read ahead by the operating system in the
+    // background, the cache and READS do not change until they are actually read.
+    void prefetch(const vector<Page> &pages){
+        vector<Page> missing;
+        for(Page page : pages){
+            Shard &shard = shardOf(page);
+            lock_guard<mutex> lock(shard.lock);
+            if(shard.frames.count(page) == 0 && shard.evicting.count(page) == 0){
+                missing.push_back(page);
             }
-            Item newItem;
-            newItem.data = diskManager->readPage(page);
-           
-            queue.push_front(page);
-            newItem.it = queue.begin();
-            pageCache[page] = move(newItem); 
-            
-            return pageCache[page].data;
         }
+        diskManager->adviseRead(missing);
+    }
+
+    // Pins page with an exclusive latch, needed to modify it through PageGuard::write
+    PageGuard pinForWrite(Page page){
+        return acquire(page, true, true);
     }
-    
+
+    // Lets edit change the cached page in place, e.g. through a MutableNodeView, and logs the page afterwards
+    template <typename Edit>
+    void editPage(Page page, Edit edit){
+        PageGuard guard = pinForWrite(page);
+        Data &data = guard.write();
+        edit(data);
+        logWrite(guard, 0, data.data(), data.size());
+    }
+
+    // A frame still pinned, e.g. by an optimistic reader, is only detached and lives until it is unpinned.
+    // A write back in flight is left to finish, if the page is reused its new frame is ordered after it. With a log
+    // the page is only freed on disk when the operation commits.
     void removePage(Page page){
-        if(pageCache.find(page) != pageCache.end()){
-            queue.remove(page);
-            pageCache.erase(page);
+        Shard &shard = shardOf(page);
+        {
+            lock_guard<mutex> lock(shard.lock);
+            auto it = shard.frames.find(page);
+            if(it != shard.frames.end()){
+                shard.policy->forget(page);
+                shard.frames.erase(it);
+            }
+        }
+        if(log != nullptr){
+            lock_guard<mutex> lock(pendingLock);
+            freedPages[this_thread::get_id()].push_back(page);
+            return;
         }
         diskManager->removePage(page);
     }
 
-    void modifyPage(Item &item, int offset, const Data &data){
-        memcpy(item.data.data() + offset, data.data(), data.size());
-        item.dirty = true;
+    void writeRecord(const Address &address, const Data &data){
+        PageGuard guard = pinForWrite(address.page);
+        memcpy(guard.write().data() + address.offset, data.data(), data.size());
+        logWrite(guard, address.offset, data.data(), data.size());
+    }
+
+    // Logs every page write as a redo record for target, the writes of an operation are kept in cache until commit
+    void setLog(WriteAheadLog *log, uint8_t target){
+        this->log = log;
+        this->logTarget = target;
     }
 
-    void writeRecord(const Address &address, const Data &data){
-        auto [page, offset] = address; 
-        if(pageCache.find(page) != pageCache.end()){
-            Item& item = promoteAngGetItem(page);
-            modifyPage(item, offset, data);
-        }
-        else{
-            if((int)queue.size() >= capacity){
-                removeLastElement();
+    // Releases the frames the calling thread changed since its last commit, which the log recorded as lsn.
+    // The pages and slots the operation freed become reusable only now, so no later commit can reuse them
+    // before the log holds the one that freed them.
+    void commit(uint64_t lsn){
+        vector<shared_ptr<Frame>> frames;
+        vector<Page> pages;
+        vector<Address> slots;
+        {
+            lock_guard<mutex> lock(pendingLock);
+            thread::id id = this_thread::get_id();
+            if(pending.count(id) > 0){
+                frames = move(pending[id]);
+                pending.erase(id);
+            }
+            if(freedPages.count(id) > 0){
+                pages = move(freedPages[id]);
+                freedPages.erase(id);
             }
+            if(freedSlots.count(id) > 0){
+                slots = move(freedSlots[id]);
+                freedSlots.erase(id);
+            }
+        }
+        for(const shared_ptr<Frame> &frame : frames){
+            uint64_t current = frame->lsn;
+            while(current < lsn && !frame->lsn.compare_exchange_weak(current, lsn)){
 
-            Item newItem;
-            newItem.data = diskManager->readPage(page);
-            modifyPage(newItem, offset, data);
+            }
+            frame->uncommitted--;
+            frame->pins--;
+        }
+        for(Page page : pages){
+            diskManager->removePage(page);
+        }
+        for(const Address &address : slots){
+            diskManager->addFreeSlot(address);
+        }
+    }
 
-            queue.push_front(page);
-            newItem.it = queue.begin();
-            pageCache[page] = move(newItem); 
+    // Switches the replacement policy, pages already cached are handed to the new one
+    void setReplacement(REPLACEMENT replacement){
+        for(auto &shard : shards){
+            lock_guard<mutex> lock(shard->lock);
+            shard->policy = makeReplacementPolicy(replacement, shard->capacity);
+            for(auto &[page, frame] : shard->frames){
+                shard->policy->admit(page);
+            }
         }
     }
 
-    Address writeRecord(const Data &data){
-        optional<Address> address = diskManager->getEmptyPosition();
+    void setPlacement(PLACEMENT placement){
+        this->placement = placement;
+    }
+
+    // Stores a new record, with KEY_LOCALITY next to the record page of its key neighbour when there is one
+    Address writeRecord(const Data &data, Page neighbour = NULL_PAGE){
+        optional<Address> address;
+        if(placement == KEY_LOCALITY && neighbour != NULL_PAGE){
+            address = diskManager->getEmptyPositionNear(neighbour, PLACEMENT_WINDOW);
+        }
+        else{
+            address = diskManager->getEmptyPosition();
+        }
         if(address != nullopt){
             writeRecord(*address, data);
             return *address;
         }
         else{
-            size_t pageSize = diskManager->getPageSize();
-            Data tombstone(pageSize, 0);
-            memcpy(tombstone.data(), data.data(), data.size());
-            Page page = writePage(tombstone);
+            // Only the record is logged, the other slots are free at once and a record another thread writes there
+            // may commit first. Redo fills the rest of a page it has not seen yet with zeros.
+            Page page = diskManager->allocatePage();
+            PageGuard guard = acquire(page, true, false);
+            guard.write().assign(diskManager->getPageSize(), 0);
+            memcpy(guard.write().data(), data.data(), data.size());
+            logWrite(guard, 0, data.data(), data.size());
+            guard.release();
 
-            for(int i = data.size(); i < pageSize; i += data.size()){
+            for(int i = data.size(); i < diskManager->getSlotsPerPage() * (int)data.size(); i += data.size()){
                 Address temp = {page, i};
                 diskManager->addFreeSlot(temp);
             }
@@ -160,29 +766,95 @@ public:
     }
 
     Data readRecord(const Address &address){
-        Data temp = readPage(address.page);
-        Data data(recordSize);
-        memcpy(data.data(), temp.data() + address.offset, data.size());
-        return data;
+        PageGuard guard = pin(address.page);
+        const Byte* begin = guard.bytes() + address.offset;
+        return Data(begin, begin + recordSize);
+    }
+
+    // Reads many records, fetching every record page only once. With asynchronous I/O the pages
+    // are read ahead in windows as large as the cache, all reads of a window in flight together,
+    // otherwise they are all hinted to the operating system up front.
+    vector<Data> readRecords(const vector<Address> &addresses){
+        vector<int> order(addresses.size());
+        for(int i = 0; i < (int)order.size(); i++){
+            order[i] = i;
+        }
+        sort(order.begin(), order.end(), [&](int a, int b){
+            return addresses[a] < addresses[b];
+        });
+
+        vector<Page> pages;
+        for(int i : order){
+            if(pages.empty() || pages.back() != addresses[i].page){
+                pages.push_back(addresses[i].page);
+            }
+        }
+        int window = min(diskManager->queueDepth(), capacity);
+        if(window <= 1){
+            prefetch(pages);
+        }
+        int current = -1;
+        int prefetched = 0;
+
+        vector<Data> records(addresses.size());
+        PageGuard guard;
+        for(int i : order){
+            const Address &address = addresses[i];
+            if(guard.getPage() != address.page){
+                guard.release();
+                current++;
+                if(window > 1 && current == prefetched){
+                    prefetched = min((int)pages.size(), current + window);
+                    load(vector<Page>(pages.begin() + current, pages.begin() + prefetched));
+                }
+                guard = pin(address.page);
+            }
+            const Byte* begin = guard.bytes() + address.offset;
+            records[i] = Data(begin, begin + recordSize);
+        }
+        return records;
     }
 
+    // With a log the slot is freed when the operation commits, like removePage
     void removeRecord(const Address &address){
+        if(log != nullptr){
+            lock_guard<mutex> lock(pendingLock);
+            freedSlots[this_thread::get_id()].push_back(address);
+            return;
+        }
         diskManager->addFreeSlot(address);
     }
 
     Data peekPage(Page page){
-        if(pageCache.find(page) != pageCache.end()){
-            return pageCache[page].data;
+        shared_ptr<Frame> frame;
+        {
+            Shard &shard = shardOf(page);
+            lock_guard<mutex> lock(shard.lock);
+            auto it = shard.frames.find(page);
+            if(it != shard.frames.end()){
+                frame = it->second;
+            }
+            else if(shard.evicting.count(page) > 0){
+                frame = shard.evicting[page];
+            }
+        }
+        if(frame != nullptr){
+            shared_lock<shared_mutex> latch(frame->latch);
+            if(frame->loaded){
+                return frame->mapped != nullptr ? Data(frame->mapped, frame->mapped + frame->mappedSize) : frame->data;
+            }
         }
-        DiskManager::READS--;
-        return diskManager->readPage(page);
+        return diskManager->peekPage(page);
     }
 
     Data peekRecord(Address address){
         Data temp = peekPage(address.page);
-        Data data(recordSize);
-        memcpy(data.data(), temp.data() + address.offset, data.size());
-        return data;
+        temp.erase(temp.begin(), temp.begin() + address.offset);
+        temp.resize(recordSize);
+        return temp;
     }
 
-};
\ No newline at end of file
+    ~BufferManager(){
+        stopCleaner();
+    }
+};
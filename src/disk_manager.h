@@ -1,121 +1,619 @@
 #pragma once
-#include <fstream>
-#include <set>
 #include <iostream>
 #include <optional>
+#include <cstring>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
 #include "types.h"
+#include "free_bitmap.h"
+#include "io_backend.h"
 
 using namespace std;
 
+// Page 0 of every file, describes the file so it can be reopened without scanning it
+struct Superblock{
+    uint32_t magic = SUPERBLOCK_MAGIC;
+    uint64_t pageSize = 0;
+    Page pages = SUPERBLOCK_PAGE + 1;
+    Page freeMapHead = NULL_PAGE;
+    Page root = NULL_PAGE;
+    int order = 0;
+
+    static const size_t size = sizeof(magic) + sizeof(pageSize) + sizeof(pages) + sizeof(freeMapHead) + sizeof(root) + sizeof(order);
+
+    Data serialize(size_t pageSize) const{
+        Data data(pageSize, 0);
+        size_t offset = 0;
+
+        memcpy(data.data() + offset, &magic, sizeof(magic));
+        offset += sizeof(magic);
+
+        memcpy(data.data() + offset, &this->pageSize, sizeof(this->pageSize));
+        offset += sizeof(this->pageSize);
+
+        memcpy(data.data() + offset, &pages, sizeof(pages));
+        offset += sizeof(pages);
+
+        memcpy(data.data() + offset, &freeMapHead, sizeof(freeMapHead));
+        offset += sizeof(freeMapHead);
+
+        memcpy(data.data() + offset, &root, sizeof(root));
+        offset += sizeof(root);
+
+        memcpy(data.data() + offset, &order, sizeof(order));
+
+        return data;
+    }
+
+    static Superblock deserialize(const Data &data){
+        Superblock superblock;
+        size_t offset = 0;
+
+        memcpy(&superblock.magic, data.data() + offset, sizeof(superblock.magic));
+        offset += sizeof(superblock.magic);
+
+        memcpy(&superblock.pageSize, data.data() + offset, sizeof(superblock.pageSize));
+        offset += sizeof(superblock.pageSize);
+
+        memcpy(&superblock.pages, data.data() + offset, sizeof(superblock.pages));
+        offset += sizeof(superblock.pages);
+
+        memcpy(&superblock.freeMapHead, data.data() + offset, sizeof(superblock.freeMapHead));
+        offset += sizeof(superblock.freeMapHead);
+
+        memcpy(&superblock.root, data.data() + offset, sizeof(superblock.root));
+        offset += sizeof(superblock.root);
+
+        memcpy(&superblock.order, data.data() + offset, sizeof(superblock.order));
+
+        return superblock;
+    }
+};
+
 class DiskManager{
-    fstream file;
+    unique_ptr<IoBackend> io;
     size_t pageSize;
-    set<Page> emptyPages;
-    set<Address> emptyPositions;
+    size_t slotSize;
+    int slotsPerPage;
+    FreeBitmap emptyPages;
+    FreeBitmap emptySlots;
+    FreeBitmap pagesWithEmptySlots;
     Page pages;
+    // Guards the free space map and the page count, page transfers run outside it
+    mutex fileLock;
+    Superblock header;
+    // First chain page of the stored free slots and which of the chain pages from there are loaded
+    Page slotPages = NULL_PAGE;
+    vector<bool> slotPagesLoaded;
+    // Whether anything changed since the last sync
+    bool dirty = false;
+
+    // Superblock and free list pages are metadata and do not count as READS / WRITES
+    void rawWrite(Page page, const Data &data){
+        if(!io->write((size_t)page * pageSize, data.data(), pageSize)){
+            throw std::runtime_error("DiskManager: Failed to write metadata page");
+        }
+    }
+
+    Data rawRead(Page page){
+        Data data(pageSize, 0);
+        if(!io->read((size_t)page * pageSize, data.data(), pageSize)){
+            throw std::runtime_error("DiskManager: Failed to read metadata page");
+        }
+        return data;
+    }
+
+    void checkPage(Page page, const char *operation){
+        if(page <= SUPERBLOCK_PAGE || page >= pages){
+            throw std::out_of_range(string("DiskManager::") + operation + ": Invalid page number");
+        }
+    }
+
+    void checkReadable(Page page, const char *operation){
+        checkPage(page, operation);
+        if(emptyPages.test(page)){
+            throw std::runtime_error(string("DiskManager::") + operation + ": Attempted to read en empty page");
+        }
+    }
+
+    int wordsPerChainPage(){
+        return (int)((pageSize - sizeof(Page) - sizeof(int)) / sizeof(uint64_t));
+    }
+
+    vector<uint64_t> readChainPage(Page page, Page *next = nullptr){
+        Data data = rawRead(page);
+        int count;
+        if(next != nullptr){
+            memcpy(next, data.data(), sizeof(Page));
+        }
+        memcpy(&count, data.data() + sizeof(Page), sizeof(count));
+        vector<uint64_t> words(count);
+        memcpy(words.data(), data.data() + sizeof(Page) + sizeof(count), count * sizeof(uint64_t));
+        return words;
+    }
+
+    // Loads the stored free slot bits first .. first + count - 1 not loaded yet
+    void loadSlots(size_t first, size_t count){
+        size_t perPage = wordsPerChainPage() * 64;
+        for(size_t i = first / perPage; i < slotPagesLoaded.size() && i <= (first + count - 1) / perPage; i++){
+            if(!slotPagesLoaded[i]){
+                slotPagesLoaded[i] = true;
+                emptySlots.merge(i * wordsPerChainPage(), readChainPage(slotPages + i));
+            }
+        }
+    }
+
+    void loadPageSlots(size_t page){
+        loadSlots(page * slotsPerPage, slotsPerPage);
+    }
+
+    // A chain page still to be loaded is about to be overwritten as a page of the file
+    void loadChainPage(Page page){
+        if(slotPages != NULL_PAGE && page >= slotPages && page - slotPages < (Page)slotPagesLoaded.size()){
+            loadSlots((size_t)(page - slotPages) * wordsPerChainPage() * 64, 1);
+        }
+    }
+
+    // The free space map is stored past the last page as a chain of [next page][count][words...] pages. The free
+    // pages and the pages with free slots come first and are loaded on open, the free slots follow from a fresh
+    // chain page on and each chain page of them is loaded when one of its slots is first used.
+    void saveFreeSpaceMap(){
+        loadSlots(0, slotPagesLoaded.size() * wordsPerChainPage() * 64);
+        slotPages = NULL_PAGE;
+        slotPagesLoaded.clear();
+        const vector<uint64_t> &pageWords = emptyPages.data();
+        const vector<uint64_t> &slotPageWords = pagesWithEmptySlots.data();
+        const vector<uint64_t> &slotWords = emptySlots.data();
+        vector<uint64_t> values = {pageWords.size(), slotPageWords.size(), slotWords.size()};
+        values.insert(values.end(), pageWords.begin(), pageWords.end());
+        values.insert(values.end(), slotPageWords.begin(), slotPageWords.end());
+
+        int perPage = wordsPerChainPage();
+        if(perPage < 3){
+            throw std::invalid_argument("DiskManager: Page is too small for the free space map");
+        }
+        int summaryChunks = ((int)values.size() + perPage - 1) / perPage;
+        int chunks = summaryChunks + ((int)slotWords.size() + perPage - 1) / perPage;
+        header.freeMapHead = pages;
+        for(int i = 0; i < chunks; i++){
+            Page next = i + 1 < chunks ? pages + i + 1 : NULL_PAGE;
+            const vector<uint64_t> &words = i < summaryChunks ? values : slotWords;
+            int start = (i < summaryChunks ? i : i - summaryChunks) * perPage;
+            int count = min(perPage, (int)words.size() - start);
+            Data data(pageSize, 0);
+            memcpy(data.data(), &next, sizeof(next));
+            memcpy(data.data() + sizeof(next), &count, sizeof(count));
+            memcpy(data.data() + sizeof(next) + sizeof(count), words.data() + start, count * sizeof(uint64_t));
+            rawWrite(pages + i, data);
+        }
+    }
+
+    void loadFreeSpaceMap(){
+        vector<uint64_t> values;
+        Page page = header.freeMapHead;
+        while(page != NULL_PAGE && (values.size() < 3 || values.size() < 3 + values[0] + values[1])){
+            vector<uint64_t> words = readChainPage(page, &page);
+            values.insert(values.end(), words.begin(), words.end());
+        }
+        if(values.empty()){
+            return;
+        }
+        size_t pageWords = values[0];
+        emptyPages.load(vector<uint64_t>(values.begin() + 3, values.begin() + 3 + pageWords));
+        pagesWithEmptySlots.load(vector<uint64_t>(values.begin() + 3 + pageWords, values.end()));
+        if(values[2] > 0){
+            slotPages = page;
+            slotPagesLoaded.assign((values[2] + wordsPerChainPage() - 1) / wordsPerChainPage(), false);
+        }
+    }
+
+    static size_t padded(size_t size, size_t alignment){
+        return (size + alignment - 1) / alignment * alignment;
+    }
+
+    // Whether pageSize is size padded to some power of two alignment of at least a sector
+    static bool paddedFrom(size_t pageSize, size_t size){
+        for(size_t alignment = SECTOR_SIZE; alignment <= pageSize; alignment *= 2){
+            if(padded(size, alignment) == pageSize){
+                return true;
+            }
+        }
+        return false;
+    }
+
+    size_t slotIndex(const Address &address){
+        return (size_t)address.page * slotsPerPage + address.offset / slotSize;
+    }
 
 public:
-    static int READS;
-    static int WRITES;
+    static atomic<int> READS;
+    static atomic<int> WRITES;
+
+    IOStats stats;
     
     DiskManager(){
         
     }
 
-    DiskManager(const string &filename, size_t pageSize){
-        file.open(filename, ios::out | ios::trunc);
-        file.close();
-        file.open(filename, ios::in | ios::out | ios::binary);
-        if(!file.is_open()){
-            throw std::runtime_error("Filed to open file " + filename);
+    DiskManager(const string &filename, size_t pageSize, bool reopen = false, bool loadFreeSpace = true, IO_BACKEND backend = DEFAULT_IO_BACKEND) :
+        DiskManager(filename, pageSize, pageSize, reopen, loadFreeSpace, backend){
+
+    }
+
+    // Creates an empty file, or with reopen attaches to a file written earlier through its superblock.
+    // Pages are divided into slots of slotSize bytes for record placement. Pages are padded to whole sectors whatever
+    // the backend, and further when direct I/O needs larger device blocks, the padding never holds slots. Pages allocated
+    // after the last sync overwrite the stored free space map, after a crash it is not loaded but rebuilt with rebuildFreeSpace.
+    DiskManager(const string &filename, size_t pageSize, size_t slotSize, bool reopen = false, bool loadFreeSpace = true, IO_BACKEND backend = DEFAULT_IO_BACKEND){
+        if(pageSize < Superblock::size){
+            throw std::invalid_argument("DiskManager: Page is too small for the superblock");
+        }
+        io = makeIoBackend(backend, filename, !reopen);
+        size_t alignment = max((size_t)SECTOR_SIZE, io->alignment());
+        this->pageSize = padded(pageSize, alignment);
+        this->slotSize = slotSize;
+        slotsPerPage = (int)(pageSize / slotSize);
+        header.pageSize = this->pageSize;
+        pages = SUPERBLOCK_PAGE + 1;
+        // A new file still needs its superblock
+        dirty = !reopen;
+
+        if(reopen){
+            header = Superblock::deserialize(rawRead(SUPERBLOCK_PAGE));
+            if(header.magic != SUPERBLOCK_MAGIC){
+                throw std::runtime_error("DiskManager: " + filename + " has no superblock");
+            }
+            // A file padded for larger device blocks keeps its page size with any backend that can address it
+            if(!paddedFrom(header.pageSize, pageSize)){
+                throw std::runtime_error("DiskManager: " + filename + " was written with a different page size");
+            }
+            if(header.pageSize % alignment != 0){
+                throw std::runtime_error("DiskManager: " + filename + " has pages smaller than the device blocks of this backend");
+            }
+            this->pageSize = header.pageSize;
+            pages = header.pages;
+            if(loadFreeSpace){
+                loadFreeSpaceMap();
+            }
+        }
+    }
+
+    const Superblock& superblock(){
+        return header;
+    }
+
+    // Root and order stored in the superblock by the next sync
+    void storeRoot(Page root, int order){
+        lock_guard<mutex> lock(fileLock);
+        if(header.root != root || header.order != order){
+            header.root = root;
+            header.order = order;
+            dirty = true;
+        }
+    }
+
+    // Writes the free list and the superblock and syncs the file, pages have to be flushed by the caller first.
+    // Does nothing when no page, slot or superblock field changed since the last sync.
+    void sync(){
+        lock_guard<mutex> lock(fileLock);
+        if(io == nullptr || !dirty){
             return;
         }
-        this->pageSize = pageSize;
-        file.seekg(0, ios::end);
-        pages = 0;
+        header.pages = pages;
+        saveFreeSpaceMap();
+        rawWrite(SUPERBLOCK_PAGE, header.serialize(pageSize));
+        io->sync();
+        dirty = false;
     }
 
-    void writePage(Page page, const Data &data){
-        if(page < 0 || page >= pages){
-            throw std::out_of_range("DiskManager::writePage: Invalid page number");
+    // Applies a logged write during recovery, the file grows when the page was allocated after the last checkpoint.
+    // Like metadata, recovery I/O does not count as READS / WRITES.
+    void redo(Page page, size_t offset, const Data &bytes){
+        lock_guard<mutex> lock(fileLock);
+        if(page <= SUPERBLOCK_PAGE || offset + bytes.size() > pageSize){
+            throw std::out_of_range("DiskManager::redo: Invalid page or offset");
+        }
+        pages = max(pages, page + 1);
+        dirty = true;
+        Data data = bytes.size() == pageSize ? bytes : rawRead(page);
+        memcpy(data.data() + offset, bytes.data(), bytes.size());
+        rawWrite(page, data);
+    }
+
+    // After recovery the free space map is rebuilt from the slots still referenced: pages without any are free,
+    // the other slots of the remaining pages are free slots
+    void rebuildFreeSpace(const vector<Address> &used){
+        lock_guard<mutex> lock(fileLock);
+        FreeBitmap usedPages;
+        FreeBitmap usedSlots;
+        for(const Address &address : used){
+            usedPages.set(address.page);
+            usedSlots.set(slotIndex(address));
         }
+        emptyPages = FreeBitmap();
+        emptySlots = FreeBitmap();
+        pagesWithEmptySlots = FreeBitmap();
+        slotPages = NULL_PAGE;
+        slotPagesLoaded.clear();
+        dirty = true;
+        for(Page page = SUPERBLOCK_PAGE + 1; page < pages; page++){
+            if(!usedPages.test(page)){
+                emptyPages.set(page);
+                continue;
+            }
+            for(int i = 0; i < slotsPerPage; i++){
+                size_t slot = (size_t)page * slotsPerPage + i;
+                if(!usedSlots.test(slot)){
+                    emptySlots.set(slot);
+                    pagesWithEmptySlots.set(page);
+                }
+            }
+        }
+    }
+
+    void writePage(Page page, const Data &data){
         if(data.size() != pageSize){
             throw std::invalid_argument("DiskManager::writePage: Invalid data size");
         }
-        WRITES++;
-        file.seekp(page * pageSize);
-        file.write(reinterpret_cast<const char*>(data.data()), pageSize);
+        {
+            lock_guard<mutex> lock(fileLock);
+            checkPage(page, "writePage");
+            dirty = true;
+            WRITES++;
+            stats.writes++;
+        }
+        if(!io->write((size_t)page * pageSize, data.data(), pageSize)){
+            throw std::runtime_error("DiskManager::writePage: Failed to write page");
+        }
+    }
+
+    // Writes several pages in page order, a run of up to MAX_WRITE_RUN adjacent pages goes out as a single
+    // vectored write. Every page counts as a write, the writes saved by merging are counted in savedWrites.
+    // With asynchronous I/O up to queueDepth runs are in flight.
+    void writePages(const vector<pair<Page, const Data*>> &pages){
+        vector<pair<Page, const Data*>> sorted(pages);
+        sort(sorted.begin(), sorted.end(), [](const pair<Page, const Data*> &a, const pair<Page, const Data*> &b){
+            return a.first < b.first;
+        });
+        vector<IoRequest> requests;
+        bool failed = false;
+        auto done = [&failed](bool ok){
+            failed |= !ok;
+        };
+        {
+            lock_guard<mutex> lock(fileLock);
+            for(int i = 0; i < (int)sorted.size(); i++){
+                auto &[page, data] = sorted[i];
+                checkPage(page, "writePages");
+                if(data->size() != pageSize){
+                    throw std::invalid_argument("DiskManager::writePages: Invalid data size");
+                }
+                if(i > 0 && page == sorted[i - 1].first + 1 && requests.back().pieces.size() < MAX_WRITE_RUN){
+                    requests.back().pieces.push_back(data->data());
+                }
+                else{
+                    requests.push_back({true, (size_t)page * pageSize, nullptr, pageSize, done, {data->data()}});
+                }
+            }
+            dirty |= !sorted.empty();
+            WRITES += (int)sorted.size();
+            stats.writes += (int)sorted.size();
+            stats.savedWrites += (int)(sorted.size() - requests.size());
+        }
+        // A single page is a plain write
+        for(IoRequest &request : requests){
+            if(request.pieces.size() == 1){
+                request.data = const_cast<Byte*>(request.pieces[0]);
+                request.pieces.clear();
+            }
+        }
+        io->run(requests);
+        if(failed){
+            throw std::runtime_error("DiskManager::writePages: Failed to write a page");
+        }
     }
 
     Page allocatePage(){
-        Page page;
-        if(!emptyPages.empty()){
-            page = *emptyPages.begin();
-            emptyPages.erase(page);
+        lock_guard<mutex> lock(fileLock);
+        dirty = true;
+        optional<size_t> page = emptyPages.first();
+        if(page != nullopt){
+            emptyPages.reset(*page);
+            return (Page)*page;
         }
-        else{
-            page = pages++;
+        if(!io->grow((size_t)(pages + 1) * pageSize)){
+            throw std::runtime_error("DiskManager::allocatePage: Failed to extend the file");
         }
-        return page;
+        loadChainPage(pages);
+        return pages++;
     }
 
     void removePage(Page page){
-        if(page < 0 || page >= pages){
+        lock_guard<mutex> lock(fileLock);
+        if(page <= SUPERBLOCK_PAGE || page >= pages){
             throw std::out_of_range("DiskManager::removePage: Invalid page number");
             return;
         }
-        emptyPages.insert(page);
+        emptyPages.set(page);
+        dirty = true;
     }
 
     void markEmpty(const Address &address){
-        emptyPositions.insert(address);
+        addFreeSlot(address);
+    }
+
+    Address takeEmptySlot(size_t page){
+        loadPageSlots(page);
+        size_t first = page * slotsPerPage;
+        size_t slot = *emptySlots.next(first);
+        emptySlots.reset(slot);
+        dirty = true;
+
+        optional<size_t> remaining = emptySlots.next(first);
+        if(remaining == nullopt || *remaining >= first + slotsPerPage){
+            pagesWithEmptySlots.reset(page);
+        }
+        return Address{(int)page, (int)((slot - first) * slotSize)};
     }
 
     optional<Address> getEmptyPosition(){
-        if(emptyPositions.empty()){
+        lock_guard<mutex> lock(fileLock);
+        optional<size_t> page = pagesWithEmptySlots.first();
+        if(page == nullopt){
             return nullopt;
         }
-        Address address = *emptyPositions.begin();
-        emptyPositions.erase(address);
+        return takeEmptySlot(*page);
+    }
 
-        return address;
+    // Free slot on the given page, or on the lowest page at most window pages away from it
+    optional<Address> getEmptyPositionNear(Page page, int window){
+        lock_guard<mutex> lock(fileLock);
+        if(pagesWithEmptySlots.test(page)){
+            return takeEmptySlot(page);
+        }
+        optional<size_t> near = pagesWithEmptySlots.next(max(0, page - window));
+        if(near == nullopt || *near > (size_t)page + window){
+            return nullopt;
+        }
+        return takeEmptySlot(*near);
     }
 
     void addFreeSlot(const Address &address){
-        emptyPositions.insert(address);
+        lock_guard<mutex> lock(fileLock);
+        loadSlots(slotIndex(address), 1);
+        emptySlots.set(slotIndex(address));
+        pagesWithEmptySlots.set(address.page);
+        dirty = true;
     }
 
+    // A page allocated but never written back reads as zeros
     Data readPage(Page page){
-        if(page < 0 || page >= pages){
-            throw std::out_of_range("DiskManager::readPage: Invalid page number");
+        {
+            lock_guard<mutex> lock(fileLock);
+            checkReadable(page, "readPage");
+            READS++;
+            stats.reads++;
         }
-        if(emptyPages.find(page) != emptyPages.end()){
-            throw std::runtime_error("DiskManager::readPage: Attempted to read en empty page");
+        Data data(pageSize, 0);
+        if(!io->read((size_t)page * pageSize, data.data(), pageSize)){
+            throw std::runtime_error("DiskManager::readPage: Failed to read page");
         }
-        READS++;
-        Data data(pageSize);
-
-        file.seekg(page * pageSize);
-        file.read(reinterpret_cast<char*>(data.data()), pageSize);
+        return data;
+    }
 
+    // Like readPage but not counted in READS or stats, for inspecting the file outside the measured I/O
+    Data peekPage(Page page){
+        {
+            lock_guard<mutex> lock(fileLock);
+            checkReadable(page, "peekPage");
+        }
+        Data data(pageSize, 0);
+        if(!io->read((size_t)page * pageSize, data.data(), pageSize)){
+            throw std::runtime_error("DiskManager::peekPage: Failed to read page");
+        }
         return data;
     }
 
+    // The page in the file mapping, nullptr when the backend does not map the file. It counts as a read like
+    // readPage and stays valid until the DiskManager is destroyed, later writes of the page show through it.
+    const Byte* mapPage(Page page){
+        lock_guard<mutex> lock(fileLock);
+        checkReadable(page, "mapPage");
+        const Byte* bytes = io->map((size_t)page * pageSize, pageSize);
+        if(bytes != nullptr){
+            READS++;
+            stats.reads++;
+        }
+        return bytes;
+    }
+
+    // Reads several pages with up to queueDepth of them in flight, done gets each page as soon as it arrives.
+    // Pages whose read failed never reach done, the call throws once the others are finished.
+    void readPages(const vector<Page> &pages, const function<void(Page, Data&)> &done){
+        vector<Data> buffers(pages.size(), Data(pageSize, 0));
+        vector<IoRequest> requests;
+        bool failed = false;
+        {
+            lock_guard<mutex> lock(fileLock);
+            for(int i = 0; i < (int)pages.size(); i++){
+                checkReadable(pages[i], "readPages");
+                requests.push_back({false, (size_t)pages[i] * pageSize, buffers[i].data(), pageSize, [&, i](bool ok){
+                    if(ok){
+                        done(pages[i], buffers[i]);
+                    }
+                    failed |= !ok;
+                }, {}});
+            }
+            READS += (int)pages.size();
+            stats.reads += (int)pages.size();
+        }
+        io->run(requests);
+        if(failed){
+            throw std::runtime_error("DiskManager::readPages: Failed to read a page");
+        }
+    }
+
+    // Hint that pages will be read soon, runs of adjacent pages are announced as one range. Invalid pages are
+    // ignored and nothing counts as a read until the pages are actually read.
+    void adviseRead(vector<Page> pages){
+        sort(pages.begin(), pages.end());
+        vector<pair<Page, Page>> ranges;
+        {
+            lock_guard<mutex> lock(fileLock);
+            for(Page page : pages){
+                if(page <= SUPERBLOCK_PAGE || page >= this->pages || emptyPages.test(page)){
+                    continue;
+                }
+                if(!ranges.empty() && page <= ranges.back().second + 1){
+                    ranges.back().second = page;
+                }
+                else{
+                    ranges.push_back({page, page});
+                }
+            }
+        }
+        for(auto &[first, last] : ranges){
+            io->willNeed((size_t)first * pageSize, (size_t)(last - first + 1) * pageSize);
+        }
+    }
+
+    // Reads and writes kept in flight by readPages and writePages, 1 without asynchronous I/O
+    int queueDepth(){
+        return io->queueDepth();
+    }
+
+    const char* backendName(){
+        return io->name();
+    }
+
     size_t getPageSize(){
         return pageSize;
     }
 
+    int getSlotsPerPage(){
+        return slotsPerPage;
+    }
+
     bool isEmpty(Address address){
-        return emptyPositions.find(address) != emptyPositions.end();
+        lock_guard<mutex> lock(fileLock);
+        loadSlots(slotIndex(address), 1);
+        return emptySlots.test(slotIndex(address));
     }
 
     Page getSize(){
+        lock_guard<mutex> lock(fileLock);
         return pages;
     }
 
+    // Destructors must not throw, a failed sync leaves the file as a crash would
     ~DiskManager(){
-        file.close();
+        try{
+            sync();
+        }
+        catch(...){
+        }
     }
 };
-int DiskManager::READS = 0;
-int DiskManager::WRITES = 0;
\ No newline at end of file
+atomic<int> DiskManager::READS{0};
+atomic<int> DiskManager::WRITES{0};
\ No newline at end of file
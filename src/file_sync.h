@@ -0,0 +1,19 @@
+#pragma once
+#include <cstdio>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+// Forces what was written to f down to the disk, not only into the operating system cache
+inline bool syncFile(FILE* f){
+    if(fflush(f) != 0){
+        return false;
+    }
+#ifdef _WIN32
+    return _commit(_fileno(f)) == 0;
+#else
+    return fsync(fileno(f)) == 0;
+#endif
+}
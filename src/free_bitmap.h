@@ -0,0 +1,120 @@
+#pragma once
+#include <vector>
+#include <optional>
+#include <stdint.h>
+
+using namespace std;
+
+inline int lowestBit(uint64_t word){
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, word);
+    return (int)index;
+#else
+    return __builtin_ctzll(word);
+#endif
+}
+
+// Set of free pages or slots, one bit each. A summary bit per word and a hint to the lowest
+// possibly non-empty summary word keep finding the lowest free bit amortized O(1).
+class FreeBitmap{
+    vector<uint64_t> words;
+    vector<uint64_t> summary;
+    size_t hint = 0;
+
+    void grow(size_t word){
+        if(word >= words.size()){
+            words.resize(word + 1, 0);
+            summary.resize(word / 64 + 1, 0);
+        }
+    }
+
+public:
+    void set(size_t bit){
+        size_t word = bit / 64;
+        grow(word);
+        words[word] |= 1ULL << (bit % 64);
+        summary[word / 64] |= 1ULL << (word % 64);
+        hint = min(hint, word / 64);
+    }
+
+    void reset(size_t bit){
+        size_t word = bit / 64;
+        if(word >= words.size()){
+            return;
+        }
+        words[word] &= ~(1ULL << (bit % 64));
+        if(words[word] == 0){
+            summary[word / 64] &= ~(1ULL << (word % 64));
+        }
+    }
+
+    bool test(size_t bit) const{
+        size_t word = bit / 64;
+        return word < words.size() && (words[word] >> (bit % 64) & 1);
+    }
+
+    // Lowest set bit
+    optional<size_t> first(){
+        while(hint < summary.size() && summary[hint] == 0){
+            hint++;
+        }
+        if(hint == summary.size()){
+            return nullopt;
+        }
+        size_t word = hint * 64 + lowestBit(summary[hint]);
+        return word * 64 + lowestBit(words[word]);
+    }
+
+    // Lowest set bit not below from
+    optional<size_t> next(size_t from) const{
+        size_t word = from / 64;
+        if(word >= words.size()){
+            return nullopt;
+        }
+        uint64_t masked = words[word] & (~0ULL << (from % 64));
+        if(masked != 0){
+            return word * 64 + lowestBit(masked);
+        }
+        word++;
+        for(size_t s = word / 64; s < summary.size(); s++){
+            uint64_t bits = summary[s];
+            if(s == word / 64){
+                bits &= (word % 64 == 0) ? ~0ULL : (~0ULL << (word % 64));
+            }
+            if(bits != 0){
+                size_t found = s * 64 + lowestBit(bits);
+                return found * 64 + lowestBit(words[found]);
+            }
+        }
+        return nullopt;
+    }
+
+    const vector<uint64_t>& data() const{
+        return words;
+    }
+
+    // Sets the bits of data starting at word offset, for loading a bitmap in parts
+    void merge(size_t offset, const vector<uint64_t> &data){
+        for(size_t i = 0; i < data.size(); i++){
+            if(data[i] != 0){
+                size_t word = offset + i;
+                grow(word);
+                words[word] |= data[i];
+                summary[word / 64] |= 1ULL << (word % 64);
+                hint = min(hint, word / 64);
+            }
+        }
+    }
+
+    void load(const vector<uint64_t> &data){
+        words = data;
+        summary.assign(words.size() / 64 + 1, 0);
+        for(size_t word = 0; word < words.size(); word++){
+            if(words[word] != 0){
+                summary[word / 64] |= 1ULL << (word % 64);
+            }
+        }
+        hint = 0;
+    }
+};
@@ -0,0 +1,718 @@
+#pragma once
+#include <fstream>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <functional>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+#include <new>
+#include <atomic>
+#include "types.h"
+#include "file_sync.h"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#endif
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#define HAVE_IO_URING
+#endif
+
+using namespace std;
+
+// One transfer of a batch, done is called with false when it failed. A write with pieces writes them one
+// after another, each size bytes long, instead of data.
+struct IoRequest{
+    bool write;
+    size_t offset;
+    Byte* data;
+    size_t size;
+    function<void(bool)> done;
+    vector<const Byte*> pieces;
+};
+
+// Moves bytes between a file and memory for DiskManager. Reading past the end of the file
+// leaves the rest of data untouched, so pages allocated but never written read as zeros.
+class IoBackend{
+public:
+    virtual ~IoBackend(){
+
+    }
+
+    virtual bool read(size_t offset, Byte *data, size_t size) = 0;
+
+    virtual bool write(size_t offset, const Byte *data, size_t size) = 0;
+
+    // Forces everything written down to the disk
+    virtual bool sync() = 0;
+
+    virtual const char* name() const = 0;
+
+    // Requests kept in flight at once by run
+    virtual int queueDepth() const{
+        return 1;
+    }
+
+    // Offsets, sizes and memory of transfers have to be multiples of it
+    virtual size_t alignment() const{
+        return 1;
+    }
+
+    // Writes pieces of size bytes each one after another from offset on, in one call where the backend can
+    virtual bool writeRun(size_t offset, const vector<const Byte*> &pieces, size_t size){
+        for(size_t i = 0; i < pieces.size(); i++){
+            if(!write(offset + i * size, pieces[i], size)){
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Makes room for a file of size bytes, backends that grow the file by writing it have nothing to do
+    virtual bool grow(size_t /*size*/){
+        return true;
+    }
+
+    // Hint that size bytes at offset will be read soon, backends that can start reading them in the background do.
+    // Nothing is read into the caller's memory.
+    virtual void willNeed(size_t /*offset*/, size_t /*size*/){
+
+    }
+
+    // The bytes of the file at offset in memory, nullptr for backends without a mapping
+    virtual const Byte* map(size_t /*offset*/, size_t /*size*/){
+        return nullptr;
+    }
+
+    // Runs every request and calls its done in the calling thread as it completes.
+    // Backends without asynchronous I/O run them one after another.
+    virtual void run(vector<IoRequest> &requests){
+        for(IoRequest &request : requests){
+            bool ok;
+            if(!request.pieces.empty()){
+                ok = writeRun(request.offset, request.pieces, request.size);
+            }
+            else{
+                ok = request.write ? write(request.offset, request.data, request.size) : read(request.offset, request.data, request.size);
+            }
+            request.done(ok);
+        }
+    }
+};
+
+// Portable backend, one seek and transfer at a time through a single stream
+class FstreamBackend : public IoBackend{
+    fstream file;
+    string filename;
+    mutex lock;
+
+public:
+    FstreamBackend(const string &filename, bool truncate) : filename(filename){
+        if(truncate){
+            file.open(filename, ios::out | ios::trunc);
+            file.close();
+        }
+        file.open(filename, ios::in | ios::out | ios::binary);
+        if(!file.is_open()){
+            throw std::runtime_error("Failed to open file " + filename);
+        }
+    }
+
+    bool read(size_t offset, Byte *data, size_t size) override{
+        lock_guard<mutex> guard(lock);
+        file.seekg((streamoff)offset);
+        file.read(reinterpret_cast<char*>(data), size);
+        // A short read past the end of the file leaves zeros, only a stream gone bad failed
+        bool ok = !file.bad();
+        file.clear();
+        return ok;
+    }
+
+    bool write(size_t offset, const Byte *data, size_t size) override{
+        lock_guard<mutex> guard(lock);
+        file.seekp((streamoff)offset);
+        file.write(reinterpret_cast<const char*>(data), size);
+        return (bool)file;
+    }
+
+    // fstream cannot sync, the data written through it is synced through a second handle
+    bool sync() override{
+        lock_guard<mutex> guard(lock);
+        file.flush();
+        FILE* handle = fopen(filename.c_str(), "rb+");
+        if(handle == nullptr){
+            return false;
+        }
+        bool synced = syncFile(handle);
+        fclose(handle);
+        return synced;
+    }
+
+    const char* name() const override{
+        return "fstream";
+    }
+};
+
+#ifndef _WIN32
+// Positioned reads and writes need no shared file position, so threads transfer pages in parallel
+class PreadBackend : public IoBackend{
+protected:
+    int fd = -1;
+
+public:
+    PreadBackend(const string &filename, bool truncate, int flags = 0){
+        fd = open(filename.c_str(), O_RDWR | O_CREAT | (truncate ? O_TRUNC : 0) | flags, 0644);
+        if(fd < 0){
+            throw std::runtime_error("Failed to open file " + filename);
+        }
+    }
+
+    PreadBackend(const PreadBackend&) = delete;
+    PreadBackend& operator=(const PreadBackend&) = delete;
+
+    bool read(size_t offset, Byte *data, size_t size) override{
+        size_t done = 0;
+        while(done < size){
+            ssize_t count = pread(fd, data + done, size - done, (off_t)(offset + done));
+            if(count < 0 && errno == EINTR){
+                continue;
+            }
+            if(count < 0){
+                return false;
+            }
+            if(count == 0){
+                break;
+            }
+            done += count;
+        }
+        return true;
+    }
+
+    bool write(size_t offset, const Byte *data, size_t size) override{
+        size_t done = 0;
+        while(done < size){
+            ssize_t count = pwrite(fd, data + done, size - done, (off_t)(offset + done));
+            if(count < 0 && errno == EINTR){
+                continue;
+            }
+            if(count <= 0){
+                return false;
+            }
+            done += count;
+        }
+        return true;
+    }
+
+    // One pwritev for the whole run, a short write is finished piece by piece
+    bool writeRun(size_t offset, const vector<const Byte*> &pieces, size_t size) override{
+        vector<iovec> vectors;
+        for(const Byte* piece : pieces){
+            vectors.push_back({const_cast<Byte*>(piece), size});
+        }
+        ssize_t count;
+        do{
+            count = pwritev(fd, vectors.data(), (int)vectors.size(), (off_t)offset);
+        }while(count < 0 && errno == EINTR);
+        if(count < 0){
+            return false;
+        }
+        for(size_t i = count / size; i < pieces.size(); i++){
+            size_t skip = i == count / size ? count % size : 0;
+            if(!PreadBackend::write(offset + i * size + skip, pieces[i] + skip, size - skip)){
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool sync() override{
+        return fsync(fd) == 0;
+    }
+
+    // The kernel reads the range into its page cache in the background
+    void willNeed(size_t offset, size_t size) override{
+#ifdef POSIX_FADV_WILLNEED
+        posix_fadvise(fd, (off_t)offset, (off_t)size, POSIX_FADV_WILLNEED);
+#endif
+    }
+
+    const char* name() const override{
+        return "pread";
+    }
+
+    ~PreadBackend(){
+        if(fd >= 0){
+            close(fd);
+        }
+    }
+};
+#endif
+
+#ifdef O_DIRECT
+// Bypasses the kernel page cache, so the buffer pool is the only cache and every page read reaches the device.
+// O_DIRECT transfers need memory, offsets and sizes aligned to the device's logical block: pages have to be padded
+// to whole blocks and are staged in a block aligned buffer of the calling thread.
+class DirectBackend : public PreadBackend{
+    struct Staging{
+        Byte* data = nullptr;
+        size_t size = 0;
+        size_t alignment = 0;
+
+        ~Staging(){
+            free(data);
+        }
+    };
+
+    size_t blockSize;
+
+    Byte* staging(size_t size){
+        thread_local Staging buffer;
+        if(buffer.size < size || buffer.alignment < blockSize){
+            void* data = nullptr;
+            if(posix_memalign(&data, blockSize, size) != 0){
+                throw std::bad_alloc();
+            }
+            free(buffer.data);
+            buffer.data = (Byte*)data;
+            buffer.size = size;
+            buffer.alignment = blockSize;
+        }
+        return buffer.data;
+    }
+
+    bool aligned(size_t offset, size_t size) const{
+        return offset % blockSize == 0 && size % blockSize == 0;
+    }
+
+    // Alignment the file system asks of direct I/O on the file, its block size where it cannot tell
+    static size_t queryBlockSize(int fd){
+#ifdef STATX_DIOALIGN
+        struct statx info;
+        if(statx(fd, "", AT_EMPTY_PATH, STATX_DIOALIGN, &info) == 0 && (info.stx_mask & STATX_DIOALIGN) != 0 && info.stx_dio_offset_align > 0){
+            return max<size_t>(info.stx_dio_offset_align, info.stx_dio_mem_align);
+        }
+#endif
+        struct statvfs fs;
+        if(fstatvfs(fd, &fs) == 0 && fs.f_bsize > 0){
+            return fs.f_bsize;
+        }
+        return SECTOR_SIZE;
+    }
+
+public:
+    // Throws when the file system does not support O_DIRECT
+    DirectBackend(const string &filename, bool truncate) : PreadBackend(filename, truncate, O_DIRECT){
+        blockSize = queryBlockSize(fd);
+    }
+
+    size_t alignment() const override{
+        return blockSize;
+    }
+
+    // Past the end of the file nothing is read, the rest of data stays untouched as with the other backends
+    bool read(size_t offset, Byte *data, size_t size) override{
+        if(!aligned(offset, size)){
+            return false;
+        }
+        Byte* buffer = staging(size);
+        size_t done = 0;
+        while(done < size){
+            ssize_t count = pread(fd, buffer + done, size - done, (off_t)(offset + done));
+            if(count < 0 && errno == EINTR){
+                continue;
+            }
+            if(count < 0){
+                return false;
+            }
+            if(count == 0){
+                break;
+            }
+            done += count;
+        }
+        memcpy(data, buffer, done);
+        return true;
+    }
+
+    bool write(size_t offset, const Byte *data, size_t size) override{
+        if(!aligned(offset, size)){
+            return false;
+        }
+        Byte* buffer = staging(size);
+        memcpy(buffer, data, size);
+        return PreadBackend::write(offset, buffer, size);
+    }
+
+    // The run is staged whole and written with one call
+    bool writeRun(size_t offset, const vector<const Byte*> &pieces, size_t size) override{
+        if(!aligned(offset, size)){
+            return false;
+        }
+        Byte* buffer = staging(pieces.size() * size);
+        for(size_t i = 0; i < pieces.size(); i++){
+            memcpy(buffer + i * size, pieces[i], size);
+        }
+        return PreadBackend::write(offset, buffer, pieces.size() * size);
+    }
+
+    // The page cache is bypassed, reading ahead into it would only waste memory
+    void willNeed(size_t, size_t) override{
+
+    }
+
+    const char* name() const override{
+        return "direct";
+    }
+};
+#endif
+
+#ifndef _WIN32
+// Maps the file into memory, pages are served as pointers into the mapping and written back with msync.
+// The mapping sits in an address range reserved up front and grows in place, so pointers handed out stay valid.
+class MmapBackend : public PreadBackend{
+    Byte* base = (Byte*)MAP_FAILED;
+    size_t reserved = MMAP_RESERVE_SIZE;
+    atomic<size_t> mapped{0};
+    mutex lock;
+
+public:
+    // Throws when the address range cannot be reserved
+    MmapBackend(const string &filename, bool truncate) : PreadBackend(filename, truncate){
+        base = (Byte*)mmap(nullptr, reserved, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if(base == MAP_FAILED){
+            throw std::runtime_error("MmapBackend: Failed to reserve address space");
+        }
+        off_t size = lseek(fd, 0, SEEK_END);
+        if(size > 0 && !grow(size)){
+            munmap(base, reserved);
+            throw std::runtime_error("MmapBackend: Failed to map " + filename);
+        }
+    }
+
+    // The file and the mapping at least double, so extending a file page by page maps it only a few times
+    bool grow(size_t size) override{
+        if(size <= mapped){
+            return true;
+        }
+        lock_guard<mutex> guard(lock);
+        size_t current = mapped;
+        if(size <= current){
+            return true;
+        }
+        size_t granularity = sysconf(_SC_PAGESIZE);
+        size_t target = max({size, 2 * current, (size_t)MMAP_MIN_SIZE});
+        target = (target + granularity - 1) / granularity * granularity;
+        if(target > reserved){
+            return false;
+        }
+        struct stat info;
+        if(fstat(fd, &info) != 0 || ((size_t)info.st_size < target && ftruncate(fd, target) != 0)){
+            return false;
+        }
+        if(mmap(base + current, target - current, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, current) == MAP_FAILED){
+            return false;
+        }
+        mapped = target;
+        return true;
+    }
+
+    const Byte* map(size_t offset, size_t size) override{
+        if(!grow(offset + size)){
+            return nullptr;
+        }
+        return base + offset;
+    }
+
+    bool read(size_t offset, Byte *data, size_t size) override{
+        size_t end = mapped;
+        if(offset < end){
+            memcpy(data, base + offset, min(size, end - offset));
+        }
+        return true;
+    }
+
+    bool write(size_t offset, const Byte *data, size_t size) override{
+        if(!grow(offset + size)){
+            return false;
+        }
+        memcpy(base + offset, data, size);
+        return true;
+    }
+
+    bool sync() override{
+        return msync(base, mapped, MS_SYNC) == 0 && PreadBackend::sync();
+    }
+
+    void willNeed(size_t offset, size_t size) override{
+        size_t granularity = sysconf(_SC_PAGESIZE);
+        size_t start = offset / granularity * granularity;
+        size_t end = min(offset + size, mapped.load());
+        if(start < end){
+            madvise(base + start, end - start, MADV_WILLNEED);
+        }
+    }
+
+    const char* name() const override{
+        return "mmap";
+    }
+
+    ~MmapBackend(){
+        munmap(base, reserved);
+    }
+};
+#endif
+
+#ifdef HAVE_IO_URING
+// Keeps up to IO_QUEUE_DEPTH reads and writes of a batch in flight through an io_uring, set up with raw system calls.
+// Single transfers use pread / pwrite. The ring is shared by all threads: whoever holds its lock submits and reaps
+// completions for everyone, and each thread calls the done callbacks of its own requests after dropping the lock.
+class UringBackend : public PreadBackend{
+    struct Pending{
+        IoRequest* request;
+        int result = 0;
+        vector<Pending*>* completed;
+        vector<iovec> vectors;
+    };
+
+    int ring = -1;
+    unsigned entries = 0;
+    unsigned inflight = 0;
+    mutex lock;
+
+    void* sqRing = MAP_FAILED;
+    void* cqRing = MAP_FAILED;
+    size_t sqRingSize = 0;
+    size_t cqRingSize = 0;
+    io_uring_sqe* sqes = (io_uring_sqe*)MAP_FAILED;
+    size_t sqesSize = 0;
+
+    unsigned* sqTail;
+    unsigned* sqMask;
+    unsigned* sqArray;
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned* cqMask;
+    io_uring_cqe* cqes;
+
+    int enter(unsigned submit, unsigned wait, unsigned flags){
+        while(true){
+            int result = (int)syscall(__NR_io_uring_enter, ring, submit, wait, flags, nullptr, 0);
+            if(result >= 0 || (errno != EINTR && errno != EAGAIN && errno != EBUSY)){
+                return result;
+            }
+        }
+    }
+
+    void queue(Pending &pending){
+        IoRequest &request = *pending.request;
+        unsigned tail = *sqTail;
+        unsigned index = tail & *sqMask;
+        io_uring_sqe &sqe = sqes[index];
+        memset(&sqe, 0, sizeof(sqe));
+        sqe.fd = fd;
+        sqe.off = request.offset;
+        if(!request.pieces.empty()){
+            for(const Byte* piece : request.pieces){
+                pending.vectors.push_back({const_cast<Byte*>(piece), request.size});
+            }
+            sqe.opcode = IORING_OP_WRITEV;
+            sqe.addr = (uint64_t)(uintptr_t)pending.vectors.data();
+            sqe.len = (unsigned)pending.vectors.size();
+        }
+        else{
+            sqe.opcode = request.write ? IORING_OP_WRITE : IORING_OP_READ;
+            sqe.addr = (uint64_t)(uintptr_t)request.data;
+            sqe.len = (unsigned)request.size;
+        }
+        sqe.user_data = (uint64_t)(uintptr_t)&pending;
+        sqArray[index] = index;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+    }
+
+    // Hands every finished request to the batch it belongs to
+    void reap(){
+        unsigned head = *cqHead;
+        unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        while(head != tail){
+            io_uring_cqe &cqe = cqes[head & *cqMask];
+            Pending* pending = (Pending*)(uintptr_t)cqe.user_data;
+            pending->result = cqe.res;
+            pending->completed->push_back(pending);
+            head++;
+            inflight--;
+        }
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+    }
+
+    // A short transfer is finished synchronously, a read hitting the end of the file is complete already.
+    // A short run is written again whole.
+    bool finish(const Pending &pending){
+        IoRequest &request = *pending.request;
+        if(pending.result < 0){
+            return false;
+        }
+        size_t done = pending.result;
+        if(!request.pieces.empty()){
+            return done == request.pieces.size() * request.size || PreadBackend::writeRun(request.offset, request.pieces, request.size);
+        }
+        if(done == request.size || (!request.write && done == 0)){
+            return true;
+        }
+        if(request.write){
+            return PreadBackend::write(request.offset + done, request.data + done, request.size - done);
+        }
+        return PreadBackend::read(request.offset + done, request.data + done, request.size - done);
+    }
+
+    void unmap(){
+        if(sqes != MAP_FAILED){
+            munmap(sqes, sqesSize);
+        }
+        if(cqRing != MAP_FAILED && cqRing != sqRing){
+            munmap(cqRing, cqRingSize);
+        }
+        if(sqRing != MAP_FAILED){
+            munmap(sqRing, sqRingSize);
+        }
+        if(ring >= 0){
+            close(ring);
+        }
+    }
+
+public:
+    // Throws when the kernel does not provide io_uring
+    UringBackend(const string &filename, bool truncate) : PreadBackend(filename, truncate){
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        ring = (int)syscall(__NR_io_uring_setup, IO_QUEUE_DEPTH, &params);
+        if(ring < 0){
+            throw std::runtime_error("UringBackend: io_uring is not available");
+        }
+        entries = min(params.sq_entries, params.cq_entries);
+
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+        if(single){
+            sqRingSize = cqRingSize = max(sqRingSize, cqRingSize);
+        }
+        sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+        cqRing = single ? sqRing : mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = (io_uring_sqe*)mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+        if(sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqes == MAP_FAILED){
+            unmap();
+            throw std::runtime_error("UringBackend: Failed to map the rings");
+        }
+
+        char* sq = (char*)sqRing;
+        char* cq = (char*)cqRing;
+        sqTail = (unsigned*)(sq + params.sq_off.tail);
+        sqMask = (unsigned*)(sq + params.sq_off.ring_mask);
+        sqArray = (unsigned*)(sq + params.sq_off.array);
+        cqHead = (unsigned*)(cq + params.cq_off.head);
+        cqTail = (unsigned*)(cq + params.cq_off.tail);
+        cqMask = (unsigned*)(cq + params.cq_off.ring_mask);
+        cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+    }
+
+    const char* name() const override{
+        return "io_uring";
+    }
+
+    int queueDepth() const override{
+        return (int)entries;
+    }
+
+    // Waiting for completions under the lock is safe, it is only done while requests are in flight
+    void run(vector<IoRequest> &requests) override{
+        vector<Pending> pending(requests.size());
+        vector<Pending*> completed;
+        for(size_t i = 0; i < requests.size(); i++){
+            pending[i].request = &requests[i];
+            pending[i].completed = &completed;
+        }
+
+        size_t submitted = 0;
+        size_t finished = 0;
+        while(finished < requests.size()){
+            vector<Pending*> ready;
+            {
+                lock_guard<mutex> guard(lock);
+                unsigned queued = 0;
+                while(submitted < requests.size() && inflight < entries){
+                    queue(pending[submitted++]);
+                    inflight++;
+                    queued++;
+                }
+                if(queued > 0 && enter(queued, 0, 0) < 0){
+                    throw std::runtime_error("UringBackend: Failed to submit requests");
+                }
+                reap();
+                if(completed.empty()){
+                    if(enter(0, 1, IORING_ENTER_GETEVENTS) < 0){
+                        throw std::runtime_error("UringBackend: Failed to wait for completions");
+                    }
+                    reap();
+                }
+                ready.swap(completed);
+            }
+            for(Pending* done : ready){
+                done->request->done(finish(*done));
+            }
+            finished += ready.size();
+        }
+    }
+
+    ~UringBackend(){
+        unmap();
+    }
+};
+#endif
+
+// io_uring, mmap and direct I/O fall back to pread where they are not available, and all of them to fstream on Windows
+inline unique_ptr<IoBackend> makeIoBackend(IO_BACKEND backend, const string &filename, bool truncate){
+#ifndef _WIN32
+#ifdef O_DIRECT
+    if(backend == DIRECT_IO){
+        try{
+            return make_unique<DirectBackend>(filename, truncate);
+        }
+        catch(const std::runtime_error&){
+
+        }
+    }
+#endif
+    if(backend == MMAP_IO){
+        try{
+            return make_unique<MmapBackend>(filename, truncate);
+        }
+        catch(const std::runtime_error&){
+
+        }
+    }
+#ifdef HAVE_IO_URING
+    if(backend == URING_IO){
+        try{
+            return make_unique<UringBackend>(filename, truncate);
+        }
+        catch(const std::runtime_error&){
+
+        }
+    }
+#endif
+    if(backend != FSTREAM_IO){
+        return make_unique<PreadBackend>(filename, truncate);
+    }
+#endif
+    return make_unique<FstreamBackend>(filename, truncate);
+}
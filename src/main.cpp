@@ -3,7 +3,11 @@
 #include <windows.h>
 #include <conio.h>
 #include <algorithm>
+#include <thread>
+#include <chrono>
+#include <filesystem>
 #include "btree.h"
+#include "bplustree.h"
 #include "record.h"
 
 using namespace std;
@@ -275,8 +279,11 @@ void test(){
 }
 
 void interacive(){
-    BTree<RecordType> btree;
-    btree.visualize();
+    cout << "OPEN THE SAVED TREE (y/n): ";
+    bool reopen = (selectOption({'y', 'n'}) == 'y');
+    system("cls");
+    unique_ptr<BTree<RecordType>> btree = reopen ? BTree<RecordType>::open("../data") : make_unique<BTree<RecordType>>();
+    btree->visualize();
     Key maxKey = 0;
 
     while(true){
@@ -296,7 +303,7 @@ void interacive(){
         if(option == '1'){
             cout << "\nINSERTING...\n";
             RecordType record = RecordType::input();
-            STATUS status = btree.insert(record);
+            STATUS status = btree->insert(record);
             if(status == OK){
                 record.print();
                 cout << " INSERTED SUCCESSFULLY\n";
@@ -327,11 +334,11 @@ void interacive(){
                 record.print();
                 cout << "\n";
                 if(pause){
-                    btree.visualize();
+                    btree->visualize();
                     cout << "CLICK ANY KEY TO RESUME\n";
                     _getch();
                 }
-                btree.insert(record);
+                btree->insert(record);
                 cout << "READS: " << DiskManager::READS - reads << "\n";
                 cout << "WRITES: " << DiskManager::WRITES - writes << "\n";
                 reads = DiskManager::READS;
@@ -343,7 +350,7 @@ void interacive(){
             Key key;
             cout << "KEY: ";
             cin >> key;
-            STATUS status = btree.remove(key);
+            STATUS status = btree->remove(key);
             if(status == OK){
                 cout << key << " REMOVED SUCCESSFULLY\n";
             }
@@ -354,7 +361,7 @@ void interacive(){
         else if(option == '4'){
             cout << "\nMODYFING...\n";
             RecordType record = RecordType::input();
-            STATUS status = btree.modify(record);
+            STATUS status = btree->modify(record);
             if(status == OK){
                 record.print();
                 cout << " MODIFIED SUCCESSFULLY\n";
@@ -368,7 +375,7 @@ void interacive(){
             Key key;
             cout << "KEY: ";
             cin >> key;
-            auto result = btree.search(key);
+            auto result = btree->search(key);
             if(result == nullopt){
                 cout << "KEY: " << key << " " << DOESNT_EXIST << "\n";
             }
@@ -379,7 +386,7 @@ void interacive(){
         }
         else if(option == '6'){
             cout << "\nPRINTING...\n";
-            btree.printAll();
+            btree->printAll();
         }
         else{
             break;
@@ -389,19 +396,515 @@ void interacive(){
             cout << "WRITES: " << DiskManager::WRITES - writes << "\n"; 
         }
         cout << "\n";
-        btree.visualize();
+        btree->visualize();
+    }
+
+}
+
+template <typename Tree>
+void benchmarkShape(const string &name, const string &tag, const vector<Key> &keys){
+    Tree btree("../data/nodes_" + tag + ".txt", "../data/records_" + tag + ".txt");
+
+    int reads = DiskManager::READS;
+    int writes = DiskManager::WRITES;
+    for(Key key : keys){
+        RecordType record = RecordType::random(key);
+        btree.insert(record);
+    }
+    int insertReads = DiskManager::READS - reads;
+    int insertWrites = DiskManager::WRITES - writes;
+
+    reads = DiskManager::READS;
+    for(Key key : keys){
+        btree.search(key);
+    }
+    int searchReads = DiskManager::READS - reads;
+
+    cout << name << "\n";
+    cout << "HEIGHT:        " << btree.getHeight() << "\n";
+    cout << "INSERT READS:  " << insertReads << "\n";
+    cout << "INSERT WRITES: " << insertWrites << "\n";
+    cout << "SEARCH READS:  " << searchReads << "\n\n";
+}
+
+// Same shape report for a B+-tree keyed by 30 to 60 byte identifiers sharing long prefixes
+template <size_t PageBytes>
+void benchmarkStringKeys(const string &name, const string &tag, const vector<Key> &keys){
+    BPlusTree<NamedRecord, PageBytes, string> btree("../data/nodes_" + tag + ".txt", "../data/records_" + tag + ".txt");
+    auto identifier = [](Key key){
+        string id = to_string(key);
+        return "tenant-" + to_string(key % 8) + "/customers/" + string(12 - id.size(), '0') + id + string(key % 31, 'x');
+    };
+
+    int reads = DiskManager::READS;
+    int writes = DiskManager::WRITES;
+    for(Key key : keys){
+        NamedRecord record = NamedRecord::random(identifier(key));
+        btree.insert(record);
+    }
+    int insertReads = DiskManager::READS - reads;
+    int insertWrites = DiskManager::WRITES - writes;
+
+    reads = DiskManager::READS;
+    for(Key key : keys){
+        btree.search(identifier(key));
+    }
+    int searchReads = DiskManager::READS - reads;
+
+    cout << name << "\n";
+    cout << "HEIGHT:        " << btree.getHeight() << "\n";
+    cout << "FILL RATIO:    " << btree.getRatio() << "\n";
+    cout << "INSERT READS:  " << insertReads << "\n";
+    cout << "INSERT WRITES: " << insertWrites << "\n";
+    cout << "SEARCH READS:  " << searchReads << "\n\n";
+}
+
+void benchmarkPlacement(PLACEMENT placement, const string &name, const vector<Key> &keys){
+    BTree<RecordType> btree("../data/nodes_placement.txt", "../data/records_placement.txt");
+    btree.setPlacement(placement);
+    for(Key key : keys){
+        RecordType record = RecordType::random(key);
+        btree.insert(record);
+    }
+
+    int reads = btree.getRecordStats().reads;
+    auto cursor = btree.scan(numeric_limits<Key>::min(), numeric_limits<Key>::max());
+    int scanned = 0;
+    while(cursor.next()){
+        scanned++;
+    }
+    cout << name << "\n";
+    cout << "RECORD PAGE READS PER SCANNED KEY: " << (double)(btree.getRecordStats().reads - reads) / max(scanned, 1) << "\n\n";
+}
+
+// Skewed trace: most searches hit a small set of hot keys, with a full scan every thousand operations
+void benchmarkReplacement(REPLACEMENT replacement, const string &name, const vector<Key> &keys){
+    BTree<RecordType> btree("../data/nodes_replacement.txt", "../data/records_replacement.txt");
+    btree.setReplacement(replacement, replacement);
+    for(Key key : keys){
+        RecordType record = RecordType::random(key);
+        btree.insert(record);
+    }
+
+    mt19937 gen(0);
+    uniform_real_distribution<double> hot(0, 1);
+    int hotKeys = max(1, (int)keys.size() / 100);
+    IOStats nodes = btree.getNodeStats();
+    IOStats records = btree.getRecordStats();
+    for(int i = 1; i <= 10 * (int)keys.size(); i++){
+        if(i % 1000 == 0){
+            auto cursor = btree.scan(numeric_limits<Key>::min(), numeric_limits<Key>::max());
+            while(cursor.next()){
+
+            }
+        }
+        int index = hot(gen) < 0.9 ? gen() % hotKeys : gen() % keys.size();
+        btree.search(keys[index]);
+    }
+    cout << name << "\n";
+    cout << "NODE READS:    " << btree.getNodeStats().reads - nodes.reads << "\n";
+    cout << "NODE WRITES:   " << btree.getNodeStats().writes - nodes.writes << "\n";
+    cout << "RECORD READS:  " << btree.getRecordStats().reads - records.reads << "\n";
+    cout << "RECORD WRITES: " << btree.getRecordStats().writes - records.writes << "\n\n";
+}
+
+// Pins random pages of a warm cache from a growing number of threads, no page misses after the warm up
+void benchmarkConcurrentReads(){
+    const int pages = 4096;
+    const int pinsPerThread = 200000;
+    DiskManager disk("../data/concurrent.txt", SECTOR_SIZE);
+    BufferManager buffer(&disk, pages);
+    for(int i = 0; i < pages; i++){
+        buffer.writePage(Data(SECTOR_SIZE, 0));
+    }
+
+    cout << "CONCURRENT READS, " << pages << " CACHED PAGES\n";
+    for(int threads = 1; threads <= (int)max(1u, thread::hardware_concurrency()); threads *= 2){
+        auto start = chrono::steady_clock::now();
+        vector<thread> workers;
+        for(int t = 0; t < threads; t++){
+            workers.emplace_back([&buffer, t](){
+                mt19937 gen(t);
+                for(int i = 0; i < pinsPerThread; i++){
+                    PageGuard guard = buffer.pin(1 + gen() % pages);
+                }
+            });
+        }
+        for(thread &worker : workers){
+            worker.join();
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << "THREADS: " << threads << ", PINS PER SECOND: " << (long long)(threads * pinsPerThread / seconds) << "\n";
+    }
+    cout << "\n";
+}
+
+// Logged inserts from several threads, each insert commits one group. Under group commit the inserts waiting for
+// the same sync share it, async commit only syncs once WAL_GROUP_SIZE commits are waiting.
+void benchmarkLog(DURABILITY durability, int threads, const string &name, const vector<Key> &keys){
+    BTree<RecordType> btree("../data/nodes_log.txt", "../data/records_log.txt", false, "../data/log.txt");
+    btree.setDurability(durability);
+    int writes = DiskManager::WRITES;
+    auto start = chrono::steady_clock::now();
+    vector<thread> workers;
+    for(int t = 0; t < threads; t++){
+        workers.emplace_back([&btree, &keys, t, threads](){
+            for(int i = t; i < (int)keys.size(); i += threads){
+                RecordType record = RecordType::random(keys[i]);
+                btree.insert(record);
+            }
+        });
+    }
+    for(thread &worker : workers){
+        worker.join();
+    }
+    btree.syncLog();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    LogStats log = btree.getLogStats();
+    cout << name << "\n";
+    cout << "LOG SYNCS:          " << log.syncs << "\n";
+    cout << "LOG BYTES / INSERT: " << (double)log.bytes / max((int)keys.size(), 1) << "\n";
+    cout << "PAGE WRITES:        " << DiskManager::WRITES - writes << "\n";
+    cout << "INSERTS PER SECOND: " << (long long)(keys.size() / seconds) << "\n\n";
+}
+
+// Logged inserts and removes from several threads, then copies of the files as a crash would leave them: pages still
+// cached are lost and reopening the copies replays the log. Every acknowledged operation has to survive.
+void benchmarkCrashRecovery(int threads, const vector<Key> &keys){
+    const string files[] = {"../data/nodes_crash", "../data/records_crash", "../data/log_crash"};
+    {
+        BTree<RecordType> btree(files[0] + ".txt", files[1] + ".txt", false, files[2] + ".txt");
+        vector<thread> workers;
+        for(int t = 0; t < threads; t++){
+            workers.emplace_back([&btree, &keys, t, threads](){
+                for(int i = t; i < (int)keys.size(); i += threads){
+                    RecordType record = RecordType::random(keys[i]);
+                    btree.insert(record);
+                    if(i % 8 == 7 && i >= threads){
+                        btree.remove(keys[i - threads]);
+                    }
+                }
+            });
+        }
+        for(thread &worker : workers){
+            worker.join();
+        }
+        for(const string &file : files){
+            filesystem::copy_file(file + ".txt", file + "_copy.txt", filesystem::copy_options::overwrite_existing);
+        }
+    }
+
+    BTree<RecordType> recovered(files[0] + "_copy.txt", files[1] + "_copy.txt", true, files[2] + "_copy.txt");
+    int lost = 0;
+    for(int i = 0; i < (int)keys.size(); i++){
+        bool removed = i + threads < (int)keys.size() && (i + threads) % 8 == 7;
+        optional<RecordType> record = recovered.search(keys[i]);
+        lost += removed ? record != nullopt : record == nullopt || record->key != keys[i];
+    }
+    cout << "CRASH RECOVERY, " << threads << " THREADS\n";
+    cout << "LOST OPERATIONS: " << lost << "\n\n";
+}
+
+// Random page reads in batches of IO_QUEUE_DEPTH, only io_uring keeps a whole batch in flight
+void benchmarkIoBackend(IO_BACKEND backend){
+    const int pages = 16384;
+    const size_t pageSize = 4096;
+    DiskManager disk("../data/io_backend.txt", pageSize, false, true, backend);
+    for(int i = 0; i < pages; i++){
+        disk.writePage(disk.allocatePage(), Data(disk.getPageSize(), 0));
+    }
+    disk.sync();
+
+    mt19937 gen(0);
+    vector<Page> batch;
+    auto start = chrono::steady_clock::now();
+    for(int i = 0; i < pages; i++){
+        batch.push_back(1 + gen() % pages);
+        if((int)batch.size() == IO_QUEUE_DEPTH || i + 1 == pages){
+            disk.readPages(batch, [](Page, Data&){
+
+            });
+            batch.clear();
+        }
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "I/O BACKEND: " << disk.backendName() << ", QUEUE DEPTH: " << disk.queueDepth() << ", PAGE READS PER SECOND: " << (long long)(pages / seconds) << "\n";
+}
+
+// Inserts with dirty pages evicted one or several at a time, a batch is written sorted with adjacent pages merged
+void benchmarkEvictionBatch(int pages, const string &name, const vector<Key> &keys){
+    BTree<RecordType> btree("../data/nodes_eviction.txt", "../data/records_eviction.txt");
+    btree.setEvictionBatch(pages);
+    for(Key key : keys){
+        RecordType record = RecordType::random(key);
+        btree.insert(record);
+    }
+    btree.checkpoint();
+
+    IOStats nodes = btree.getNodeStats();
+    IOStats records = btree.getRecordStats();
+    cout << name << "\n";
+    cout << "PAGE WRITES:  " << nodes.writes + records.writes << "\n";
+    cout << "SAVED WRITES: " << nodes.savedWrites + records.savedWrites << "\n";
+    cout << "PAGE READS:   " << nodes.reads + records.reads << "\n\n";
+}
+
+// Random pins of a cache holding a sixteenth of the file, one in ten for writing. The cleaner writes dirty pages
+// before they reach the end of the LRU list, so misses evict clean pages.
+void benchmarkCleaner(int frames){
+    const int pages = 4096;
+    const int capacity = 256;
+    DiskManager disk("../data/cleaner.txt", SECTOR_SIZE);
+    BufferManager buffer(&disk, capacity);
+    for(int i = 0; i < pages; i++){
+        buffer.writePage(Data(SECTOR_SIZE, 0));
+    }
+    buffer.flush();
+    buffer.setCleaner(frames);
+
+    WriteBackStats before = buffer.getWriteBackStats();
+    mt19937 gen(0);
+    for(int i = 0; i < 50 * pages; i++){
+        Page page = 1 + gen() % pages;
+        if(i % 10 == 0){
+            PageGuard guard = buffer.pinForWrite(page);
+            guard.write()[0]++;
+        }
+        else{
+            PageGuard guard = buffer.pin(page);
+        }
+    }
+    WriteBackStats after = buffer.getWriteBackStats();
+    cout << "CLEANER FRAMES: " << frames << ", FOREGROUND WRITES: " << after.foreground - before.foreground
+         << ", BACKGROUND WRITES: " << after.background - before.background << "\n";
+}
+
+// Searches of every key, with a mapped file cached pages are read in place instead of copied from disk
+void benchmarkLookups(IO_BACKEND backend, const string &name, const vector<Key> &keys){
+    BTree<RecordType> btree("../data/nodes_lookup.txt", "../data/records_lookup.txt", false, "", backend);
+    for(Key key : keys){
+        RecordType record = RecordType::random(key);
+        btree.insert(record);
+    }
+
+    auto start = chrono::steady_clock::now();
+    for(Key key : keys){
+        btree.search(key);
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << name << "\n";
+    cout << "MICROSECONDS PER SEARCH: " << seconds * 1e6 / max((int)keys.size(), 1) << "\n\n";
+}
+
+// Reads of looking the keys up one at a time and in batches of batchSize walking the tree together
+void benchmarkSearchMany(int batchSize, const vector<Key> &keys){
+    BTree<RecordType> btree("../data/nodes_multiget.txt", "../data/records_multiget.txt");
+    for(Key key : keys){
+        RecordType record = RecordType::random(key);
+        btree.insert(record);
+    }
+
+    int reads = DiskManager::READS;
+    for(Key key : keys){
+        btree.search(key);
+    }
+    int singleReads = DiskManager::READS - reads;
+
+    reads = DiskManager::READS;
+    for(int i = 0; i < (int)keys.size(); i += batchSize){
+        btree.searchMany(vector<Key>(keys.begin() + i, keys.begin() + min(i + batchSize, (int)keys.size())));
+    }
+    int batchReads = DiskManager::READS - reads;
+
+    cout << "MULTI-GET, " << batchSize << " KEYS PER BATCH\n";
+    cout << "SINGLE SEARCH READS: " << singleReads << "\n";
+    cout << "BATCHED READS:       " << batchReads << "\n\n";
+}
+
+// I/O per record of loading the keys one insert at a time and in sorted batches sharing their descents
+void benchmarkInsertBatch(int batchSize, const string &name, const vector<Key> &keys){
+    BTree<RecordType> btree("../data/nodes_batch.txt", "../data/records_batch.txt");
+
+    int reads = DiskManager::READS;
+    int writes = DiskManager::WRITES;
+    if(batchSize <= 1){
+        for(Key key : keys){
+            RecordType record = RecordType::random(key);
+            btree.insert(record);
+        }
+    }
+    else{
+        for(int i = 0; i < (int)keys.size(); i += batchSize){
+            vector<RecordType> batch;
+            for(int j = i; j < min(i + batchSize, (int)keys.size()); j++){
+                batch.push_back(RecordType::random(keys[j]));
+            }
+            btree.insertBatch(batch);
+        }
+    }
+    double records = max((int)keys.size(), 1);
+    cout << name << "\n";
+    cout << "READS PER RECORD:  " << (DiskManager::READS - reads) / records << "\n";
+    cout << "WRITES PER RECORD: " << (DiskManager::WRITES - writes) / records << "\n\n";
+}
+
+// I/O per record of loading the keys sorted, one insert at a time and bottom-up with nodes filled to fillFactor
+void benchmarkBulkLoad(double fillFactor, const string &name, vector<Key> keys){
+    BTree<RecordType> btree("../data/nodes_bulk.txt", "../data/records_bulk.txt");
+    sort(keys.begin(), keys.end());
+    vector<RecordType> records;
+    for(Key key : keys){
+        records.push_back(RecordType::random(key));
+    }
+
+    int reads = DiskManager::READS;
+    int writes = DiskManager::WRITES;
+    if(fillFactor <= 0){
+        for(RecordType &record : records){
+            btree.insert(record);
+        }
+    }
+    else{
+        btree.bulkLoad(records.begin(), records.end(), fillFactor);
+    }
+    double count = max((int)records.size(), 1);
+    cout << name << "\n";
+    cout << "READS PER RECORD:  " << (DiskManager::READS - reads) / count << "\n";
+    cout << "WRITES PER RECORD: " << (DiskManager::WRITES - writes) / count << "\n";
+    cout << "HEIGHT:            " << btree.getHeight() << "\n\n";
+}
+
+// Probe throughput of a full node of order D, over the deserialized entries and over the page bytes
+template <int D>
+void benchmarkNodeSearch(const string &name, int probes){
+    Node<D> node;
+    for(int i = 0; i < Node<D>::MAX_ENTRIES; i++){
+        node.entries.push_back({2 * (Key)i, {0, 0}});
+    }
+    Data data = node.serialize();
+    NodeView<D> view(data);
+
+    default_random_engine rng(D);
+    uniform_int_distribution<Key> distribution(-1, 2 * Node<D>::MAX_ENTRIES);
+    vector<Key> keys(probes);
+    for(Key &key : keys){
+        key = distribution(rng);
+    }
+
+    long long sum = 0;
+    auto start = chrono::steady_clock::now();
+    for(Key key : keys){
+        sum += node.searchPlace({key, {0, 0}});
+    }
+    double entriesSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    for(Key key : keys){
+        sum -= view.searchPlace(key);
+    }
+    double viewSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << name << "\n";
+    cout << "MILLION PROBES PER SECOND, ENTRIES: " << probes / max(entriesSeconds, 1e-9) / 1e6 << "\n";
+    cout << "MILLION PROBES PER SECOND, KEYS ON PAGE: " << probes / max(viewSeconds, 1e-9) / 1e6 << "\n";
+    if(sum != 0){
+        cout << "SEARCH MISMATCH\n";
+    }
+    cout << "\n";
+}
+
+void benchmark(){
+    cout << "NUMBER OF RECORDS: ";
+    int n;
+    cin >> n;
+
+    vector<Key> keys;
+    for(int i = 0; i < n; i++){
+        keys.push_back(i);
     }
+    random_device rd;
+    default_random_engine rng(rd());
+    shuffle(keys.begin(), keys.end(), rng);
 
+    using Paged4K = PagedBTree<RecordType, 4096>;
+    using Paged16K = PagedBTree<RecordType, 16384>;
+    benchmarkShape<BTree<RecordType>>("B-TREE, D = " + to_string(DEFAULT_ORDER), "btree", keys);
+    benchmarkShape<Paged4K>("B-TREE, 4 KiB PAGES, D = " + to_string(Paged4K::ORDER), "btree_4k", keys);
+    benchmarkShape<Paged16K>("B-TREE, 16 KiB PAGES, D = " + to_string(Paged16K::ORDER), "btree_16k", keys);
+    benchmarkShape<BPlusTree<RecordType, 4096>>("B+-TREE, 4 KiB PAGES", "bplus_4k", keys);
+    benchmarkShape<BPlusTree<RecordType, 16384>>("B+-TREE, 16 KiB PAGES", "bplus_16k", keys);
+    benchmarkShape<CompactBPlusTree<RecordType, 4096>>("B+-TREE, COMPACT NODES, 4 KiB PAGES", "bplus_compact_4k", keys);
+    benchmarkShape<CompactBPlusTree<RecordType, 16384>>("B+-TREE, COMPACT NODES, 16 KiB PAGES", "bplus_compact_16k", keys);
+    benchmarkStringKeys<4096>("B+-TREE, STRING KEYS, 4 KiB PAGES", "bplus_string_4k", keys);
+
+    benchmarkPlacement(FIRST_FIT, "FIRST FIT PLACEMENT", keys);
+    benchmarkPlacement(KEY_LOCALITY, "KEY LOCALITY PLACEMENT", keys);
+
+    benchmarkReplacement(LRU_POLICY, "LRU REPLACEMENT", keys);
+    benchmarkReplacement(CLOCK_POLICY, "CLOCK REPLACEMENT", keys);
+    benchmarkReplacement(TWO_Q_POLICY, "2Q REPLACEMENT", keys);
+    benchmarkReplacement(LRU_K_POLICY, "LRU-2 REPLACEMENT", keys);
+    benchmarkReplacement(ARC_POLICY, "ARC REPLACEMENT", keys);
+
+    benchmarkConcurrentReads();
+
+    benchmarkLog(GROUP_COMMIT, 1, "LOGGED INSERTS, GROUP COMMIT, 1 THREAD", keys);
+    benchmarkLog(GROUP_COMMIT, 8, "LOGGED INSERTS, GROUP COMMIT, 8 THREADS", keys);
+    benchmarkLog(ASYNC_COMMIT, 1, "LOGGED INSERTS, ASYNC COMMIT, 1 THREAD", keys);
+    benchmarkCrashRecovery(4, keys);
+
+    benchmarkEvictionBatch(1, "EVICTION BATCH 1", keys);
+    benchmarkEvictionBatch(4, "EVICTION BATCH 4", keys);
+
+    benchmarkCleaner(0);
+    benchmarkCleaner(16);
+    benchmarkCleaner(64);
+    cout << "\n";
+
+    benchmarkIoBackend(FSTREAM_IO);
+    benchmarkIoBackend(PREAD_IO);
+    benchmarkIoBackend(URING_IO);
+    benchmarkIoBackend(MMAP_IO);
+    benchmarkIoBackend(DIRECT_IO);
+    cout << "\n";
+
+    benchmarkLookups(FSTREAM_IO, "LOOKUPS, FSTREAM", keys);
+    benchmarkLookups(PREAD_IO, "LOOKUPS, PREAD", keys);
+    benchmarkLookups(MMAP_IO, "LOOKUPS, MMAP", keys);
+    benchmarkLookups(DIRECT_IO, "LOOKUPS, DIRECT I/O", keys);
+
+    benchmarkSearchMany(256, keys);
+
+    benchmarkInsertBatch(1, "SINGLE INSERTS", keys);
+    benchmarkInsertBatch(10000, "BATCHED INSERTS, 10000 PER BATCH", keys);
+
+    benchmarkBulkLoad(0, "SORTED INSERTS", keys);
+    benchmarkBulkLoad(1.0, "BULK LOAD, FULL NODES", keys);
+    benchmarkBulkLoad(0.7, "BULK LOAD, NODES 70% FULL", keys);
+
+    benchmarkNodeSearch<DEFAULT_ORDER>("NODE SEARCH, D = " + to_string(DEFAULT_ORDER), 1 << 22);
+    benchmarkNodeSearch<orderForPage(4096)>("NODE SEARCH, 4 KiB PAGES, D = " + to_string(orderForPage(4096)), 1 << 22);
+    benchmarkNodeSearch<orderForPage(16384)>("NODE SEARCH, 16 KiB PAGES, D = " + to_string(orderForPage(16384)), 1 << 22);
 }
 
 int main(){
     cout << "SELECT MODE:\n";
     cout << "1. INTERACTIVE\n";
     cout << "2. TESTING\n";
-    char option = selectOption({'1', '2'});
+    cout << "3. BENCHMARK\n";
+    char option = selectOption({'1', '2', '3'});
     system("cls");
 
-    option == '1' ? interacive() : test();
+    if(option == '1'){
+        interacive();
+    }
+    else if(option == '2'){
+        test();
+    }
+    else{
+        benchmark();
+    }
 
     return 0;
 }
\ No newline at end of file
@@ -2,6 +2,9 @@
 #include <string>
 #include "types.h"
 #include <algorithm>
+#if defined(__AVX2__) || defined(__SSE4_2__)
+#include <immintrin.h>
+#endif
 
 using namespace std;
 
@@ -42,14 +45,87 @@ struct NodeEntry{
     }
 };
 
+constexpr size_t NODE_HEADER_SIZE = sizeof(bool) + sizeof(int);
+
+constexpr size_t nodeBytes(int d){
+    return NODE_HEADER_SIZE + 2 * d * NodeEntry::size + (2 * d + 1) * sizeof(Page);
+}
+
+constexpr size_t alignToSector(size_t bytes){
+    return (bytes + SECTOR_SIZE - 1) / SECTOR_SIZE * SECTOR_SIZE;
+}
+
+// Largest order whose node still fits in a page of pageBytes, e.g. BTree<Record, orderForPage(4096)>
+constexpr int orderForPage(size_t pageBytes){
+    if(pageBytes < nodeBytes(1)){
+        return 0;
+    }
+    return (int)((pageBytes - nodeBytes(0)) / (nodeBytes(1) - nodeBytes(0)));
+}
+
+// Number of keys not greater than key among count sorted keys stored contiguously at keys, which
+// may be unaligned. Binary search narrows the range to RANK_WINDOW keys, which are then compared
+// four (AVX2) or two (SSE4.2) at a time.
+inline int rankSearch(const Byte *keys, int count, Key key){
+    auto keyAt = [keys](int i){
+        Key k;
+        memcpy(&k, keys + i * sizeof(Key), sizeof(k));
+        return k;
+    };
+
+    int low = 0, high = count;
+    while(high - low > RANK_WINDOW){
+        int mid = (low + high) / 2;
+        if(keyAt(mid) <= key){
+            low = mid + 1;
+        }
+        else{
+            high = mid;
+        }
+    }
+
+    int rank = low, i = low;
+#if defined(__AVX2__)
+    __m256i probe = _mm256_set1_epi64x(key);
+    for(; i + 4 <= high; i += 4){
+        __m256i block = _mm256_loadu_si256((const __m256i*)(keys + i * sizeof(Key)));
+        int greater = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(block, probe)));
+        rank += 4 - __builtin_popcount(greater);
+    }
+#elif defined(__SSE4_2__)
+    __m128i probe = _mm_set1_epi64x(key);
+    for(; i + 2 <= high; i += 2){
+        __m128i block = _mm_loadu_si128((const __m128i*)(keys + i * sizeof(Key)));
+        int greater = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(block, probe)));
+        rank += 2 - __builtin_popcount(greater);
+    }
+#endif
+    for(; i < high; i++){
+        rank += keyAt(i) <= key;
+    }
+    return rank;
+}
+
+// On the page the keys, the record addresses and the children are kept in separate arrays, so
+// that the keys of a node are contiguous and can be searched with rankSearch
+template <int D>
 struct Node{
+    static_assert(D >= 1, "Node: order must be at least 1");
 
     bool leaf = false;
-    Page parent = NULL_PAGE;
     vector<NodeEntry> entries;
     vector<Page> children;
 
-    static const size_t size = sizeof(leaf) + sizeof(parent) + sizeof(int) + 2 * D * NodeEntry::size + (2 * D + 1) * sizeof(Page);
+    static constexpr int MAX_ENTRIES = 2 * D;
+    static constexpr int MIN_ENTRIES = D;
+    static const size_t size = alignToSector(nodeBytes(D));
+
+    static const size_t LEAF_OFFSET = 0;
+    static const size_t COUNT_OFFSET = LEAF_OFFSET + sizeof(bool);
+    static const size_t KEYS_OFFSET = COUNT_OFFSET + sizeof(int);
+    static const size_t ADDRESSES_OFFSET = KEYS_OFFSET + MAX_ENTRIES * sizeof(Key);
+    static const size_t ADDRESS_SIZE = NodeEntry::size - sizeof(Key);
+    static const size_t CHILDREN_OFFSET = ADDRESSES_OFFSET + MAX_ENTRIES * ADDRESS_SIZE;
 
     int searchPlace(const NodeEntry &entry){
         return upper_bound(entries.begin(), entries.end(), entry) - entries.begin();
@@ -107,65 +183,129 @@ struct Node{
 
     Data serialize(){
         Data data(size, 0);
-        size_t offset = 0;
-        
-        memcpy(data.data() + offset, &parent, sizeof(parent));
-        offset += sizeof(parent);
-
-        memcpy(data.data() + offset, &leaf, sizeof(leaf));
-        offset += sizeof(leaf);
+        int count = (int)entries.size();
 
-        int count = (int)entries.size(); 
-        memcpy(data.data() + offset, &count, sizeof(count));
-        offset += sizeof(count);
+        memcpy(data.data() + LEAF_OFFSET, &leaf, sizeof(leaf));
+        memcpy(data.data() + COUNT_OFFSET, &count, sizeof(count));
 
-        size_t temp = offset;
-
-        for(int i = 0; i < entries.size(); i++){
-            entries[i].serialize(data, offset); 
+        for(int i = 0; i < count; i++){
+            size_t offset = ADDRESSES_OFFSET + i * ADDRESS_SIZE;
+            memcpy(data.data() + KEYS_OFFSET + i * sizeof(Key), &entries[i].key, sizeof(Key));
+            memcpy(data.data() + offset, &entries[i].address.page, sizeof(entries[i].address.page));
+            memcpy(data.data() + offset + sizeof(int), &entries[i].address.offset, sizeof(entries[i].address.offset));
         }
-        
-        offset = temp + (2 * D) * NodeEntry::size;        
-        for(int i = 0; i < children.size(); i++){
-            memcpy(data.data() + offset, &children[i], sizeof(children[i]));
-            offset += sizeof(children[i]);
+
+        // A new root is written before it gets its first child
+        if(!leaf && !children.empty()){
+            memcpy(data.data() + CHILDREN_OFFSET, children.data(), children.size() * sizeof(Page));
         }
-        
         return data;
     }
 
     static Node deserialize(const Data &data){
         Node node;
-        size_t offset = 0;
-
-        memcpy(&node.parent, data.data() + offset, sizeof(node.parent));
-        offset += sizeof(node.parent);
-
-        memcpy(&node.leaf, data.data() + offset, sizeof(node.leaf));
-        offset += sizeof(node.leaf);
-
         int count;
-        memcpy(&count, data.data() + offset, sizeof(count));
-        offset += sizeof(count);
 
-        size_t temp = offset;
+        memcpy(&node.leaf, data.data() + LEAF_OFFSET, sizeof(node.leaf));
+        memcpy(&count, data.data() + COUNT_OFFSET, sizeof(count));
+
+        node.entries.resize(count);
         for(int i = 0; i < count; i++){
-            NodeEntry entry = NodeEntry::deserialize(data, offset);
-            node.entries.push_back(entry);
+            NodeEntry &entry = node.entries[i];
+            size_t offset = ADDRESSES_OFFSET + i * ADDRESS_SIZE;
+            memcpy(&entry.key, data.data() + KEYS_OFFSET + i * sizeof(Key), sizeof(entry.key));
+            memcpy(&entry.address.page, data.data() + offset, sizeof(entry.address.page));
+            memcpy(&entry.address.offset, data.data() + offset + sizeof(int), sizeof(entry.address.offset));
         }
-        
-        offset = temp + (2 * D) * NodeEntry::size;
 
         if(!node.leaf){
-            for(int i = 0; i < count + 1; i++){
-                Page child;
-                memcpy(&child, data.data() + offset, sizeof(child));
-                offset += sizeof(child);
-                node.children.push_back(child);
-            }
+            node.children.resize(count + 1);
+            memcpy(node.children.data(), data.data() + CHILDREN_OFFSET, (count + 1) * sizeof(Page));
         }
 
         return node;
     }
 
+};
+
+// Read-only node over the bytes of a cached page, valid for as long as the page stays pinned
+template <int D>
+class NodeView{
+protected:
+    using Layout = Node<D>;
+    const Byte* bytes;
+
+    template <typename V>
+    V get(size_t offset) const{
+        V value;
+        memcpy(&value, bytes + offset, sizeof(value));
+        return value;
+    }
+
+public:
+    explicit NodeView(const Data &data) : bytes(data.data()) {}
+
+    explicit NodeView(const Byte *bytes) : bytes(bytes) {}
+
+    bool leaf() const{
+        return get<bool>(Layout::LEAF_OFFSET);
+    }
+
+    int count() const{
+        return get<int>(Layout::COUNT_OFFSET);
+    }
+
+    Key key(int i) const{
+        return get<Key>(Layout::KEYS_OFFSET + i * sizeof(Key));
+    }
+
+    Address address(int i) const{
+        size_t offset = Layout::ADDRESSES_OFFSET + i * Layout::ADDRESS_SIZE;
+        return {get<int>(offset), get<int>(offset + sizeof(int))};
+    }
+
+    NodeEntry entry(int i) const{
+        return {key(i), address(i)};
+    }
+
+    Page child(int i) const{
+        return get<Page>(Layout::CHILDREN_OFFSET + i * sizeof(Page));
+    }
+
+    int searchPlace(Key k) const{
+        return rankSearch(bytes + Layout::KEYS_OFFSET, count(), k);
+    }
+
+    int searchChild(Page page) const{
+        if(leaf()){
+            return NULL_PAGE;
+        }
+        for(int i = 0; i <= count(); i++){
+            if(child(i) == page){
+                return i;
+            }
+        }
+        return NULL_PAGE;
+    }
+};
+
+// Writable node over a pinned page obtained through PageGuard::write, which marks it dirty
+template <int D>
+class MutableNodeView : public NodeView<D>{
+    using Layout = Node<D>;
+
+    template <typename V>
+    void set(size_t offset, const V &value){
+        memcpy(const_cast<Byte*>(this->bytes) + offset, &value, sizeof(value));
+    }
+
+public:
+    explicit MutableNodeView(Data &data) : NodeView<D>(data) {}
+
+    void setEntry(int i, const NodeEntry &entry){
+        size_t offset = Layout::ADDRESSES_OFFSET + i * Layout::ADDRESS_SIZE;
+        set(Layout::KEYS_OFFSET + i * sizeof(Key), entry.key);
+        set(offset, entry.address.page);
+        set(offset + sizeof(int), entry.address.offset);
+    }
 };
\ No newline at end of file
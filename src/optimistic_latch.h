@@ -0,0 +1,183 @@
+#pragma once
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <stdint.h>
+#include "types.h"
+
+using namespace std;
+
+// Version word of a node. Writers lock it exclusively, readers remember the version they saw
+// and validate it after reading, so they never block writers. Bit 0 is the lock bit.
+class OptimisticLatch{
+    atomic<uint64_t> word{0};
+
+public:
+    // Version of an unlocked node, waits while a writer holds it
+    uint64_t readLock() const{
+        while(true){
+            uint64_t version = word.load(memory_order_acquire);
+            if((version & 1) == 0){
+                return version;
+            }
+            this_thread::yield();
+        }
+    }
+
+    // True when no writer locked the node since version was read. Node contents are read under the
+    // frame latch of the buffer pool, which already orders them before this load.
+    bool validate(uint64_t version) const{
+        return word.load(memory_order_acquire) == version;
+    }
+
+    void lock(){
+        while(true){
+            uint64_t version = word.load(memory_order_relaxed);
+            if((version & 1) == 0 && word.compare_exchange_weak(version, version | 1, memory_order_acquire)){
+                return;
+            }
+            this_thread::yield();
+        }
+    }
+
+    // Publishes a new version, readers that saw the old one restart
+    void unlock(){
+        word.fetch_add(1, memory_order_release);
+    }
+
+    // Restores the version seen before locking, for nodes that were only inspected
+    void unlockUnchanged(){
+        word.fetch_sub(1, memory_order_release);
+    }
+};
+
+// Latch for every page of a file. Chunks are allocated on first use and never move,
+// so a latch can be looked up without holding any lock.
+class LatchTable{
+    vector<atomic<OptimisticLatch*>> chunks;
+
+public:
+    LatchTable() : chunks(LATCH_CHUNKS){
+
+    }
+
+    LatchTable(const LatchTable&) = delete;
+    LatchTable& operator=(const LatchTable&) = delete;
+
+    OptimisticLatch& operator[](Page page){
+        size_t chunk = (size_t)page / LATCH_CHUNK_SIZE;
+        if(page < 0 || chunk >= chunks.size()){
+            throw std::out_of_range("LatchTable: Invalid page number");
+        }
+        OptimisticLatch* latches = chunks[chunk].load(memory_order_acquire);
+        if(latches == nullptr){
+            OptimisticLatch* fresh = new OptimisticLatch[LATCH_CHUNK_SIZE];
+            if(chunks[chunk].compare_exchange_strong(latches, fresh, memory_order_acq_rel)){
+                latches = fresh;
+            }
+            else{
+                delete[] fresh;
+            }
+        }
+        return latches[page % LATCH_CHUNK_SIZE];
+    }
+
+    ~LatchTable(){
+        for(auto &chunk : chunks){
+            delete[] chunk.load();
+        }
+    }
+};
+
+// Latches one writer holds while crabbing down a tree: optionally the root pointer, then pages along its path.
+// Whatever is still held when it goes out of scope is unlocked as changed.
+class WriteLatches{
+    OptimisticLatch &rootLatch;
+    LatchTable &latches;
+    bool rootHeld = false;
+    vector<Page> pages;
+
+public:
+    WriteLatches(OptimisticLatch &rootLatch, LatchTable &latches) : rootLatch(rootLatch), latches(latches){
+
+    }
+
+    WriteLatches(const WriteLatches&) = delete;
+    WriteLatches& operator=(const WriteLatches&) = delete;
+
+    void lockRoot(){
+        rootLatch.lock();
+        rootHeld = true;
+    }
+
+    bool holdsRoot() const{
+        return rootHeld;
+    }
+
+    void lock(Page page){
+        latches[page].lock();
+        pages.push_back(page);
+    }
+
+    // Takes over a page the writer locked itself
+    void adopt(Page page){
+        pages.push_back(page);
+    }
+
+    // Releases the root pointer and every page above the last locked one except keep, none of them was modified
+    void releaseAncestors(Page keep = NULL_PAGE){
+        if(rootHeld){
+            rootLatch.unlockUnchanged();
+            rootHeld = false;
+        }
+        vector<Page> kept;
+        for(int i = 0; i + 1 < (int)pages.size(); i++){
+            if(pages[i] == keep){
+                kept.push_back(keep);
+            }
+            else{
+                latches[pages[i]].unlockUnchanged();
+            }
+        }
+        if(!pages.empty()){
+            kept.push_back(pages.back());
+        }
+        pages = move(kept);
+    }
+
+    // Unlocks a page that was just freed, so its number can be reused while the writer goes on
+    void unlockFreed(Page page){
+        auto it = find(pages.begin(), pages.end(), page);
+        if(it != pages.end()){
+            latches[page].unlock();
+            pages.erase(it);
+        }
+    }
+
+    void release(bool changed){
+        for(Page page : pages){
+            if(changed){
+                latches[page].unlock();
+            }
+            else{
+                latches[page].unlockUnchanged();
+            }
+        }
+        pages.clear();
+        if(rootHeld){
+            if(changed){
+                rootLatch.unlock();
+            }
+            else{
+                rootLatch.unlockUnchanged();
+            }
+            rootHeld = false;
+        }
+    }
+
+    ~WriteLatches(){
+        release(true);
+    }
+};
@@ -3,6 +3,7 @@
 #include <string>
 #include <random>
 #include <fstream>
+#include <stdexcept>
 
 using namespace std;
 
@@ -98,4 +99,66 @@ struct Record{
     bool operator==(const Record &other) const {
         return key == other.key && angle == other.angle && radius == other.radius;
     }
-};
\ No newline at end of file
+};
+
+// Record keyed by a string of up to NAME_KEY_SIZE - 1 bytes, for BPlusTree<NamedRecord, PageBytes, string>
+struct NamedRecord{
+    string key;
+    double angle;
+    double radius;
+
+    static const size_t size = NAME_KEY_SIZE + sizeof(angle) + sizeof(radius);
+
+    NamedRecord(const string &k = "", double a = 0, double r = 0){
+        key = k;
+        angle = a;
+        radius = r;
+    }
+
+    Data serialize(){
+        if(key.size() >= NAME_KEY_SIZE){
+            throw invalid_argument("NamedRecord: key longer than " + to_string(NAME_KEY_SIZE - 1) + " bytes");
+        }
+        Data data(size, 0);
+        size_t curr = 0;
+
+        data[curr] = (Byte)key.size();
+        memcpy(data.data() + curr + 1, key.data(), key.size());
+        curr += NAME_KEY_SIZE;
+
+        memcpy(data.data() + curr, &angle, sizeof(angle));
+        curr += sizeof(angle);
+
+        memcpy(data.data() + curr, &radius, sizeof(radius));
+
+        return data;
+    }
+
+    static NamedRecord deserialize(const Data &data){
+        NamedRecord record;
+        size_t curr = 0;
+
+        record.key.assign((const char*)data.data() + curr + 1, data[curr]);
+        curr += NAME_KEY_SIZE;
+
+        memcpy(&record.angle, data.data() + curr, sizeof(angle));
+        curr += sizeof(angle);
+
+        memcpy(&record.radius, data.data() + curr, sizeof(radius));
+
+        return record;
+    }
+
+    static NamedRecord random(const string &key){
+        Record record = Record::random(0);
+        return NamedRecord(key, record.angle, record.radius);
+    }
+
+    void print(){
+        cout << "[KEY: " << key << ", ANGLE: " << angle << ", RADIUS: " << radius << "]";
+    }
+
+    bool operator==(const NamedRecord &other) const {
+        return key == other.key && angle == other.angle && radius == other.radius;
+    }
+};
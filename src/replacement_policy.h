@@ -0,0 +1,512 @@
+#pragma once
+#include <list>
+#include <set>
+#include <deque>
+#include <tuple>
+#include <memory>
+#include <optional>
+#include <functional>
+#include <unordered_map>
+#include "types.h"
+
+using namespace std;
+
+using Evictable = function<bool(Page)>;
+
+// Decides which cached page BufferManager evicts. The policy only sees page numbers,
+// evictable tells it which resident pages are not pinned.
+class ReplacementPolicy{
+public:
+    // A missing page was loaded into the cache
+    virtual void admit(Page page) = 0;
+
+    // A cached page was accessed again
+    virtual void touch(Page page) = 0;
+
+    // Picks an evictable page and drops it from the resident set, nullopt when every page is pinned
+    virtual optional<Page> victim(const Evictable &evictable) = 0;
+
+    // A cached page was deleted, its history is dropped as well
+    virtual void forget(Page page) = 0;
+
+    // The page the last victim call returned stays cached after all, it goes back as the coldest page
+    // of where it was taken from without counting as an access
+    virtual void restore(Page page) = 0;
+
+    // Up to count resident pages in the order they would be evicted, without evicting them
+    virtual vector<Page> coldest(int count) = 0;
+
+    virtual ~ReplacementPolicy(){
+
+    }
+};
+
+// Recency ordered list of pages with O(1) move to front and removal
+class PageList{
+    list<Page> pages;
+    unordered_map<Page, list<Page>::iterator> positions;
+
+public:
+    void pushFront(Page page){
+        pages.push_front(page);
+        positions[page] = pages.begin();
+    }
+
+    void pushBack(Page page){
+        pages.push_back(page);
+        positions[page] = prev(pages.end());
+    }
+
+    void moveToFront(Page page){
+        pages.splice(pages.begin(), pages, positions[page]);
+    }
+
+    bool contains(Page page) const{
+        return positions.find(page) != positions.end();
+    }
+
+    void erase(Page page){
+        auto it = positions.find(page);
+        if(it != positions.end()){
+            pages.erase(it->second);
+            positions.erase(it);
+        }
+    }
+
+    optional<Page> back(){
+        if(pages.empty()){
+            return nullopt;
+        }
+        return pages.back();
+    }
+
+    // Least recently used evictable page, removed from the list
+    optional<Page> takeLast(const Evictable &evictable){
+        for(auto it = pages.rbegin(); it != pages.rend(); it++){
+            if(evictable(*it)){
+                Page page = *it;
+                erase(page);
+                return page;
+            }
+        }
+        return nullopt;
+    }
+
+    int size() const{
+        return (int)pages.size();
+    }
+
+    // Appends least recently used pages to result until it holds count
+    void takeColdest(vector<Page> &result, int count) const{
+        for(auto it = pages.rbegin(); it != pages.rend() && (int)result.size() < count; it++){
+            result.push_back(*it);
+        }
+    }
+};
+
+class LRUPolicy : public ReplacementPolicy{
+    PageList queue;
+
+public:
+    void admit(Page page) override{
+        queue.pushFront(page);
+    }
+
+    void touch(Page page) override{
+        queue.moveToFront(page);
+    }
+
+    optional<Page> victim(const Evictable &evictable) override{
+        return queue.takeLast(evictable);
+    }
+
+    void forget(Page page) override{
+        queue.erase(page);
+    }
+
+    void restore(Page page) override{
+        queue.pushBack(page);
+    }
+
+    vector<Page> coldest(int count) override{
+        vector<Page> pages;
+        queue.takeColdest(pages, count);
+        return pages;
+    }
+};
+
+// Second chance: new pages start without a reference bit, so a single scan does not push out pages used twice
+class ClockPolicy : public ReplacementPolicy{
+    struct Frame{
+        Page page;
+        bool referenced;
+    };
+
+    vector<Frame> frames;
+    vector<int> freeFrames;
+    unordered_map<Page, int> positions;
+    int hand = 0;
+    // Where the hand stood before the last victim, and the frames whose reference bit that sweep cleared
+    int startHand = 0;
+    vector<int> cleared;
+
+public:
+    void admit(Page page) override{
+        int frame;
+        if(!freeFrames.empty()){
+            frame = freeFrames.back();
+            freeFrames.pop_back();
+        }
+        else{
+            frame = (int)frames.size();
+            frames.push_back({});
+        }
+        frames[frame] = {page, false};
+        positions[page] = frame;
+    }
+
+    void touch(Page page) override{
+        frames[positions[page]].referenced = true;
+    }
+
+    optional<Page> victim(const Evictable &evictable) override{
+        int size = (int)frames.size();
+        startHand = hand;
+        cleared.clear();
+        for(int step = 0; step < 2 * size; step++){
+            Frame &frame = frames[hand];
+            hand = (hand + 1) % size;
+            if(frame.page == NULL_PAGE || !evictable(frame.page)){
+                continue;
+            }
+            if(frame.referenced){
+                frame.referenced = false;
+                cleared.push_back(hand == 0 ? size - 1 : hand - 1);
+                continue;
+            }
+            Page page = frame.page;
+            forget(page);
+            return page;
+        }
+        return nullopt;
+    }
+
+    void forget(Page page) override{
+        auto it = positions.find(page);
+        if(it != positions.end()){
+            frames[it->second] = {NULL_PAGE, false};
+            freeFrames.push_back(it->second);
+            positions.erase(it);
+        }
+    }
+
+    // Back into the frame it was taken from, admit reuses the frame freed last. The hand and the reference bits
+    // the sweep cleared are set back too.
+    void restore(Page page) override{
+        admit(page);
+        for(int frame : cleared){
+            frames[frame].referenced = true;
+        }
+        hand = startHand;
+    }
+
+    // Pages without a reference bit in the order the hand reaches them, then the referenced ones
+    vector<Page> coldest(int count) override{
+        vector<Page> pages;
+        int size = (int)frames.size();
+        for(int referenced = 0; referenced < 2; referenced++){
+            for(int step = 0; step < size && (int)pages.size() < count; step++){
+                const Frame &frame = frames[(hand + step) % size];
+                if(frame.page != NULL_PAGE && frame.referenced == (referenced == 1)){
+                    pages.push_back(frame.page);
+                }
+            }
+        }
+        return pages;
+    }
+};
+
+// 2Q: first-time pages wait in a FIFO, only pages seen again after leaving it enter the LRU queue
+class TwoQueuePolicy : public ReplacementPolicy{
+    PageList in;
+    PageList out;
+    PageList hot;
+    int inCapacity;
+    int outCapacity;
+    // Whether the last victim came from the FIFO
+    bool victimFromIn = false;
+
+public:
+    TwoQueuePolicy(int capacity){
+        inCapacity = max(1, capacity / 4);
+        outCapacity = max(1, capacity / 2);
+    }
+
+    void admit(Page page) override{
+        if(out.contains(page)){
+            out.erase(page);
+            hot.pushFront(page);
+        }
+        else{
+            in.pushFront(page);
+        }
+    }
+
+    void touch(Page page) override{
+        if(hot.contains(page)){
+            hot.moveToFront(page);
+        }
+    }
+
+    optional<Page> victim(const Evictable &evictable) override{
+        if(in.size() > inCapacity || hot.size() == 0){
+            optional<Page> page = in.takeLast(evictable);
+            if(page != nullopt){
+                out.pushFront(*page);
+                if(out.size() > outCapacity){
+                    out.erase(*out.back());
+                }
+                victimFromIn = true;
+                return page;
+            }
+        }
+        optional<Page> page = hot.takeLast(evictable);
+        if(page != nullopt){
+            victimFromIn = false;
+            return page;
+        }
+        page = in.takeLast(evictable);
+        if(page != nullopt){
+            out.pushFront(*page);
+            victimFromIn = true;
+        }
+        return page;
+    }
+
+    void forget(Page page) override{
+        in.erase(page);
+        out.erase(page);
+        hot.erase(page);
+    }
+
+    // Not through admit, a page back from out would count as seen twice and enter the LRU queue
+    void restore(Page page) override{
+        if(victimFromIn){
+            out.erase(page);
+            in.pushBack(page);
+        }
+        else{
+            hot.pushBack(page);
+        }
+    }
+
+    vector<Page> coldest(int count) override{
+        vector<Page> pages;
+        bool inFirst = in.size() > inCapacity || hot.size() == 0;
+        (inFirst ? in : hot).takeColdest(pages, count);
+        (inFirst ? hot : in).takeColdest(pages, count);
+        return pages;
+    }
+};
+
+// LRU-K: evicts the page whose K-th most recent access is the oldest, pages with fewer than K
+// accesses go first. History of evicted pages is retained for a while.
+class LRUKPolicy : public ReplacementPolicy{
+    struct History{
+        deque<long long> accesses;
+    };
+
+    int k;
+    int retainedCapacity;
+    long long clock = 0;
+    unordered_map<Page, History> resident;
+    unordered_map<Page, History> retained;
+    PageList retainedOrder;
+    set<tuple<long long, long long, Page>> order;
+
+    tuple<long long, long long, Page> rank(Page page, const History &history){
+        long long kth = (int)history.accesses.size() < k ? 0 : history.accesses.front();
+        return {kth, history.accesses.back(), page};
+    }
+
+    void record(History &history){
+        history.accesses.push_back(++clock);
+        if((int)history.accesses.size() > k){
+            history.accesses.pop_front();
+        }
+    }
+
+public:
+    LRUKPolicy(int capacity, int k = 2) : k(k), retainedCapacity(2 * capacity){
+
+    }
+
+    void admit(Page page) override{
+        History history;
+        auto it = retained.find(page);
+        if(it != retained.end()){
+            history = move(it->second);
+            retained.erase(it);
+            retainedOrder.erase(page);
+        }
+        record(history);
+        order.insert(rank(page, history));
+        resident[page] = move(history);
+    }
+
+    void touch(Page page) override{
+        History &history = resident[page];
+        order.erase(rank(page, history));
+        record(history);
+        order.insert(rank(page, history));
+    }
+
+    optional<Page> victim(const Evictable &evictable) override{
+        for(auto it = order.begin(); it != order.end(); it++){
+            Page page = get<2>(*it);
+            if(!evictable(page)){
+                continue;
+            }
+            order.erase(it);
+            retained[page] = move(resident[page]);
+            resident.erase(page);
+            retainedOrder.pushFront(page);
+            if(retainedOrder.size() > retainedCapacity){
+                Page oldest = *retainedOrder.back();
+                retainedOrder.erase(oldest);
+                retained.erase(oldest);
+            }
+            return page;
+        }
+        return nullopt;
+    }
+
+    void forget(Page page) override{
+        auto it = resident.find(page);
+        if(it != resident.end()){
+            order.erase(rank(page, it->second));
+            resident.erase(it);
+        }
+        retained.erase(page);
+        retainedOrder.erase(page);
+    }
+
+    // The history moves back from retained unchanged, admit would record another access
+    void restore(Page page) override{
+        History history = move(retained[page]);
+        retained.erase(page);
+        retainedOrder.erase(page);
+        order.insert(rank(page, history));
+        resident[page] = move(history);
+    }
+
+    vector<Page> coldest(int count) override{
+        vector<Page> pages;
+        for(auto it = order.begin(); it != order.end() && (int)pages.size() < count; it++){
+            pages.push_back(get<2>(*it));
+        }
+        return pages;
+    }
+};
+
+// ARC: balances a recency list and a frequency list, moving the target size p on hits in their ghost lists
+class ARCPolicy : public ReplacementPolicy{
+    PageList recent;
+    PageList frequent;
+    PageList recentGhosts;
+    PageList frequentGhosts;
+    int capacity;
+    double target = 0;
+
+public:
+    ARCPolicy(int capacity) : capacity(capacity){
+
+    }
+
+    void admit(Page page) override{
+        if(recentGhosts.contains(page)){
+            target = min<double>(capacity, target + max(1.0, (double)frequentGhosts.size() / recentGhosts.size()));
+            recentGhosts.erase(page);
+            frequent.pushFront(page);
+        }
+        else if(frequentGhosts.contains(page)){
+            target = max(0.0, target - max(1.0, (double)recentGhosts.size() / frequentGhosts.size()));
+            frequentGhosts.erase(page);
+            frequent.pushFront(page);
+        }
+        else{
+            recent.pushFront(page);
+        }
+
+        while(recent.size() + recentGhosts.size() > capacity && recentGhosts.size() > 0){
+            recentGhosts.erase(*recentGhosts.back());
+        }
+        while(recent.size() + frequent.size() + recentGhosts.size() + frequentGhosts.size() > 2 * capacity && frequentGhosts.size() > 0){
+            frequentGhosts.erase(*frequentGhosts.back());
+        }
+    }
+
+    void touch(Page page) override{
+        if(recent.contains(page)){
+            recent.erase(page);
+            frequent.pushFront(page);
+        }
+        else{
+            frequent.moveToFront(page);
+        }
+    }
+
+    optional<Page> victim(const Evictable &evictable) override{
+        bool fromRecent = recent.size() > 0 && (recent.size() > target || frequent.size() == 0);
+        for(int attempt = 0; attempt < 2; attempt++, fromRecent = !fromRecent){
+            optional<Page> page = (fromRecent ? recent : frequent).takeLast(evictable);
+            if(page != nullopt){
+                (fromRecent ? recentGhosts : frequentGhosts).pushFront(*page);
+                return page;
+            }
+        }
+        return nullopt;
+    }
+
+    void forget(Page page) override{
+        recent.erase(page);
+        frequent.erase(page);
+        recentGhosts.erase(page);
+        frequentGhosts.erase(page);
+    }
+
+    // Out of the ghost list it was just put on, admit would take it for a ghost hit and move the target
+    void restore(Page page) override{
+        if(recentGhosts.contains(page)){
+            recentGhosts.erase(page);
+            recent.pushBack(page);
+        }
+        else{
+            frequentGhosts.erase(page);
+            frequent.pushBack(page);
+        }
+    }
+
+    vector<Page> coldest(int count) override{
+        vector<Page> pages;
+        bool recentFirst = recent.size() > 0 && (recent.size() > target || frequent.size() == 0);
+        (recentFirst ? recent : frequent).takeColdest(pages, count);
+        (recentFirst ? frequent : recent).takeColdest(pages, count);
+        return pages;
+    }
+};
+
+inline unique_ptr<ReplacementPolicy> makeReplacementPolicy(REPLACEMENT replacement, int capacity){
+    switch(replacement){
+        case CLOCK_POLICY:
+            return make_unique<ClockPolicy>();
+        case TWO_Q_POLICY:
+            return make_unique<TwoQueuePolicy>(capacity);
+        case LRU_K_POLICY:
+            return make_unique<LRUKPolicy>(capacity);
+        case ARC_POLICY:
+            return make_unique<ARCPolicy>(capacity);
+        default:
+            return make_unique<LRUPolicy>();
+    }
+}
@@ -1,11 +1,34 @@
 #pragma once
 
-#define D                   2
+#define DEFAULT_ORDER       2
+#define SECTOR_SIZE         512
 #define NODES_CACHE_SIZE    5
 #define BLOCKING_FACTOR     5
 #define RECORDS_CACHE_SIZE  5
+#define SCAN_BATCH_SIZE     64
+#define NAME_KEY_SIZE       64
+#define RANK_WINDOW         16
+#define PLACEMENT_WINDOW    1
+#define BUFFER_SHARDS       16
+#define SHARD_MIN_FRAMES    64
+#define LATCH_CHUNK_SIZE    4096
+#define LATCH_CHUNKS        16384
+#define WAL_GROUP_SIZE      64
+#define WAL_CHECKPOINT_SIZE 16777216
+#define IO_QUEUE_DEPTH      64
+#define MAX_WRITE_RUN       64
+#define CLEANER_INTERVAL    10
+#define MMAP_MIN_SIZE       1048576
+#define MMAP_RESERVE_SIZE   (1ULL << 36)
 #define NULL_PAGE           -1
 #define NULL_KEY            -1
+#define SUPERBLOCK_PAGE     0
+#define SUPERBLOCK_MAGIC    0x42545245
+#ifdef _WIN32
+#define DEFAULT_IO_BACKEND  FSTREAM_IO
+#else
+#define DEFAULT_IO_BACKEND  PREAD_IO
+#endif
 
 #include <vector>
 #include <stdint.h>
@@ -16,6 +39,30 @@ using Byte = uint8_t;
 using Data = vector<Byte>;
 using Key = long long;
 enum STATUS { OK, ALREADY_EXISTS, DOESNT_EXIST };
+enum PLACEMENT { FIRST_FIT, KEY_LOCALITY };
+enum REPLACEMENT { LRU_POLICY, CLOCK_POLICY, TWO_Q_POLICY, LRU_K_POLICY, ARC_POLICY };
+enum DURABILITY { GROUP_COMMIT, ASYNC_COMMIT };
+enum IO_BACKEND { FSTREAM_IO, PREAD_IO, URING_IO, MMAP_IO, DIRECT_IO };
+enum NODE_ENCODING { PLAIN_NODES, COMPACT_NODES };
+
+struct IOStats{
+    int reads = 0;
+    int writes = 0;
+    // Page writes merged into the write of an adjacent page
+    int savedWrites = 0;
+};
+
+// Pages written back by evictions and by the background cleaner, flushes are not counted
+struct WriteBackStats{
+    int foreground = 0;
+    int background = 0;
+};
+
+struct LogStats{
+    int commits = 0;
+    int syncs = 0;
+    long long bytes = 0;
+};
 ostream& operator<<(ostream& os, STATUS c){
     switch(c){
         case OK:
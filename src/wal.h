@@ -0,0 +1,263 @@
+#pragma once
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <thread>
+#include <atomic>
+#include <optional>
+#include <functional>
+#include <stdexcept>
+#include "types.h"
+#include "file_sync.h"
+
+using namespace std;
+
+// Redo log of page writes. The writes of one operation are staged per thread and appended as a single group
+// when it commits: [size][checksum][has root][root] followed by [file][page][offset][length][bytes] records.
+// A group torn by a crash fails its checksum, so recovery applies only operations that committed entirely.
+class WriteAheadLog{
+    FILE* file = nullptr;
+    string filename;
+    mutex lock;
+    condition_variable flushed;
+    unordered_map<thread::id, Data> staged;
+    // Committed groups not written to the file yet
+    Data buffer;
+    int buffered = 0;
+    uint64_t lastLsn = 0;
+    atomic<uint64_t> durableLsn{0};
+    bool flushing = false;
+    long long size = 0;
+    DURABILITY durability = GROUP_COMMIT;
+
+    static const size_t GROUP_HEADER = sizeof(uint32_t) + sizeof(uint32_t);
+
+    static void put(Data &data, const void *value, size_t size){
+        const Byte* bytes = reinterpret_cast<const Byte*>(value);
+        data.insert(data.end(), bytes, bytes + size);
+    }
+
+    static uint32_t checksum(const Byte *data, size_t size){
+        uint32_t hash = 2166136261u;
+        for(size_t i = 0; i < size; i++){
+            hash = (hash ^ data[i]) * 16777619u;
+        }
+        return hash;
+    }
+
+public:
+    LogStats stats;
+
+    // Without truncate the log left by an earlier run is kept for replay
+    WriteAheadLog(const string &filename, bool truncate) : filename(filename){
+        file = fopen(filename.c_str(), truncate ? "wb+" : "ab+");
+        if(file == nullptr){
+            throw std::runtime_error("WriteAheadLog: Failed to open " + filename);
+        }
+        fseek(file, 0, SEEK_END);
+        size = ftell(file);
+    }
+
+    // True when there is nothing to replay, a missing file included
+    static bool isEmpty(const string &filename){
+        FILE* f = fopen(filename.c_str(), "rb");
+        if(f == nullptr){
+            return true;
+        }
+        fseek(f, 0, SEEK_END);
+        bool empty = ftell(f) == 0;
+        fclose(f);
+        return empty;
+    }
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    void setDurability(DURABILITY durability){
+        lock_guard<mutex> guard(lock);
+        this->durability = durability;
+    }
+
+    // Stages a write of the calling thread until its operation commits
+    void append(uint8_t target, Page page, size_t offset, const Byte *data, size_t length){
+        uint32_t offset32 = (uint32_t)offset;
+        uint32_t length32 = (uint32_t)length;
+        lock_guard<mutex> guard(lock);
+        Data &records = staged[this_thread::get_id()];
+        put(records, &target, sizeof(target));
+        put(records, &page, sizeof(page));
+        put(records, &offset32, sizeof(offset32));
+        put(records, &length32, sizeof(length32));
+        put(records, data, length);
+    }
+
+    // Appends the staged writes of the calling thread as one group, root is logged when the operation changed it.
+    // Returns the LSN of the group, 0 when there was nothing to log.
+    uint64_t commit(optional<Page> root){
+        lock_guard<mutex> guard(lock);
+        auto it = staged.find(this_thread::get_id());
+        if(root == nullopt && (it == staged.end() || it->second.empty())){
+            return 0;
+        }
+        Data payload;
+        uint8_t hasRoot = root != nullopt;
+        Page rootPage = root.value_or(NULL_PAGE);
+        put(payload, &hasRoot, sizeof(hasRoot));
+        put(payload, &rootPage, sizeof(rootPage));
+        if(it != staged.end()){
+            payload.insert(payload.end(), it->second.begin(), it->second.end());
+            staged.erase(it);
+        }
+        uint32_t length = (uint32_t)payload.size();
+        uint32_t sum = checksum(payload.data(), payload.size());
+        put(buffer, &length, sizeof(length));
+        put(buffer, &sum, sizeof(sum));
+        buffer.insert(buffer.end(), payload.begin(), payload.end());
+
+        buffered++;
+        size += GROUP_HEADER + payload.size();
+        stats.commits++;
+        return ++lastLsn;
+    }
+
+    // Writes and syncs the log up to lsn. One thread syncs at a time, whoever waits meanwhile
+    // is covered by the next sync together with everything committed in between.
+    void flushTo(uint64_t lsn){
+        unique_lock<mutex> guard(lock);
+        while(durableLsn < lsn){
+            if(flushing){
+                flushed.wait(guard);
+                continue;
+            }
+            flushing = true;
+            Data batch = move(buffer);
+            buffer.clear();
+            buffered = 0;
+            uint64_t upTo = lastLsn;
+            guard.unlock();
+
+            bool written = fwrite(batch.data(), 1, batch.size(), file) == batch.size() && syncFile(file);
+
+            guard.lock();
+            flushing = false;
+            flushed.notify_all();
+            if(!written){
+                throw std::runtime_error("WriteAheadLog: Failed to write " + filename);
+            }
+            durableLsn = upTo;
+            stats.syncs++;
+            stats.bytes += batch.size();
+        }
+    }
+
+    void flush(){
+        uint64_t lsn;
+        {
+            lock_guard<mutex> guard(lock);
+            lsn = lastLsn;
+        }
+        flushTo(lsn);
+    }
+
+    // Returns once the commit is as durable as asked for. With GROUP_COMMIT it is on disk, commits waiting for
+    // the same sync share it. ASYNC_COMMIT returns before that and only syncs once WAL_GROUP_SIZE commits are
+    // waiting, a crash loses the commits not synced yet.
+    void waitFor(uint64_t lsn){
+        if(lsn == 0){
+            return;
+        }
+        bool sync;
+        {
+            lock_guard<mutex> guard(lock);
+            sync = durability == GROUP_COMMIT || buffered >= WAL_GROUP_SIZE;
+        }
+        if(sync){
+            flushTo(lsn);
+        }
+    }
+
+    // Every commit up to it is on disk
+    uint64_t getDurableLsn() const{
+        return durableLsn;
+    }
+
+    // Bytes a replay would have to read
+    long long getSize(){
+        lock_guard<mutex> guard(lock);
+        return size;
+    }
+
+    // Applies every complete group in commit order and returns the root logged last, the first torn
+    // or corrupt group ends the log
+    optional<Page> replay(const function<void(uint8_t, Page, size_t, const Data&)> &redo){
+        lock_guard<mutex> guard(lock);
+        optional<Page> root;
+        fseek(file, 0, SEEK_SET);
+        while(true){
+            uint32_t length, sum;
+            if(fread(&length, sizeof(length), 1, file) != 1 || fread(&sum, sizeof(sum), 1, file) != 1){
+                break;
+            }
+            if(length < sizeof(uint8_t) + sizeof(Page)){
+                break;
+            }
+            Data payload(length);
+            if(fread(payload.data(), 1, length, file) != length || checksum(payload.data(), length) != sum){
+                break;
+            }
+
+            uint8_t hasRoot;
+            Page rootPage;
+            size_t offset = 0;
+            memcpy(&hasRoot, payload.data() + offset, sizeof(hasRoot));
+            offset += sizeof(hasRoot);
+            memcpy(&rootPage, payload.data() + offset, sizeof(rootPage));
+            offset += sizeof(rootPage);
+            while(offset < payload.size()){
+                uint8_t target;
+                Page page;
+                uint32_t at, bytes;
+                memcpy(&target, payload.data() + offset, sizeof(target));
+                offset += sizeof(target);
+                memcpy(&page, payload.data() + offset, sizeof(page));
+                offset += sizeof(page);
+                memcpy(&at, payload.data() + offset, sizeof(at));
+                offset += sizeof(at);
+                memcpy(&bytes, payload.data() + offset, sizeof(bytes));
+                offset += sizeof(bytes);
+                redo(target, page, at, Data(payload.begin() + offset, payload.begin() + offset + bytes));
+                offset += bytes;
+            }
+            if(hasRoot){
+                root = rootPage;
+            }
+        }
+        fseek(file, 0, SEEK_END);
+        return root;
+    }
+
+    // Empties the log once everything it describes is on disk in the data files
+    void truncate(){
+        unique_lock<mutex> guard(lock);
+        flushed.wait(guard, [this](){
+            return !flushing;
+        });
+        file = freopen(filename.c_str(), "wb+", file);
+        if(file == nullptr){
+            throw std::runtime_error("WriteAheadLog: Failed to truncate " + filename);
+        }
+        buffer.clear();
+        buffered = 0;
+        durableLsn = lastLsn;
+        size = 0;
+    }
+
+    ~WriteAheadLog(){
+        if(file != nullptr){
+            fclose(file);
+        }
+    }
+};